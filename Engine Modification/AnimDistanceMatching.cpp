@@ -0,0 +1,739 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+//Charlie - Distance Matching implementation
+#include "AnimNodes/AnimDistanceMatching.h"
+#include "Animation/AnimSequence.h"
+#include "Animation/BlendSpaceBase.h"
+#include "Animation/AnimCurveTypes.h"
+#include "Algo/BinarySearch.h"
+#include "Animation/Skeleton.h"
+#include "HAL/IConsoleManager.h"
+#if WITH_EDITOR
+#include "UObject/UObjectGlobals.h"
+#endif
+
+// Divide segments visited by queries for the average search length
+DECLARE_DWORD_COUNTER_STAT(TEXT("DistanceMatching Queries"), STAT_DistanceMatchingQueries, STATGROUP_Anim);
+DECLARE_DWORD_COUNTER_STAT(TEXT("DistanceMatching Segments Visited"), STAT_DistanceMatchingSegmentsVisited, STATGROUP_Anim);
+
+static int32 GDistanceMatchingNormalizedResolution = 33;
+static FAutoConsoleVariableRef CVarDistanceMatchingNormalizedResolution(
+	TEXT("a.DistanceMatching.NormalizedResolution"),
+	GDistanceMatchingNormalizedResolution,
+	TEXT("Number of evenly spaced entries in the normalized distance tables that blend space distance matching blends. Changing it rebuilds every table"),
+	FConsoleVariableDelegate::CreateLambda([](IConsoleVariable*) { FDistanceMatchingTableCache::Reset(); }),
+	ECVF_Default);
+
+static float GDistanceMatchingBlendSpaceMaxError = 0.01f;
+static FAutoConsoleVariableRef CVarDistanceMatchingBlendSpaceMaxError(
+	TEXT("a.DistanceMatching.BlendSpaceMaxError"),
+	GDistanceMatchingBlendSpaceMaxError,
+	TEXT("Largest error in normalized time allowed when blend space distance matching leaves out keys of the normalized distance tables. 0 keeps every key"),
+	FConsoleVariableDelegate::CreateLambda([](IConsoleVariable*) { FDistanceMatchingTableCache::Reset(); }),
+	ECVF_Default);
+
+SmartName::UID_Type DistanceMatching::ResolveCurveUID(const USkeleton* Skeleton, FName CurveName)
+{
+	FSmartName CurveSmartName;
+	if (Skeleton && CurveName != NAME_None && Skeleton->GetSmartNameByName(USkeleton::AnimCurveMappingName, CurveName, CurveSmartName))
+	{
+		return CurveSmartName.UID;
+	}
+	return SmartName::MaxUID;
+}
+
+void DistanceMatching::AddWeighted(TArrayView<float> InOutValues, TArrayView<const float> Values, float Weight)
+{
+	check(InOutValues.Num() == Values.Num());
+
+	const int32 NumValues = Values.Num();
+	float* Dest = InOutValues.GetData();
+	const float* Source = Values.GetData();
+	int32 Index = 0;
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS
+	const VectorRegister VectorWeight = VectorSetFloat1(Weight);
+	for (; Index + 4 <= NumValues; Index += 4)
+	{
+		VectorStore(VectorMultiplyAdd(VectorLoad(Source + Index), VectorWeight, VectorLoad(Dest + Index)), Dest + Index);
+	}
+#endif // PLATFORM_ENABLE_VECTORINTRINSICS
+
+	for (; Index < NumValues; ++Index)
+	{
+		Dest[Index] += Source[Index] * Weight;
+	}
+}
+
+int32 DistanceMatching::FindLowerBound(TArrayView<const float> Distances, float Distance, int32 HintIndex)
+{
+	const int32 NumEntries = Distances.Num();
+	INC_DWORD_STAT(STAT_DistanceMatchingQueries);
+
+	// The answer lies in [Low, High]
+	int32 Low = 0;
+	int32 High = NumEntries;
+	int32 NumVisited = 0;
+
+	if (Distances.IsValidIndex(HintIndex))
+	{
+		// Gallop away from the hint in steps of 1, 2, 4... until the answer is bracketed.
+		// Small moves are found straight away, and large jumps (e.g. wrapping around a loop) cost no more than a binary search
+		++NumVisited;
+		if (Distances[HintIndex] >= Distance)
+		{
+			High = HintIndex;
+			for (int32 Step = 1;; Step *= 2)
+			{
+				const int32 Probe = High - Step;
+				if (Probe < 0)
+				{
+					break;
+				}
+
+				++NumVisited;
+				if (Distances[Probe] < Distance)
+				{
+					Low = Probe + 1;
+					break;
+				}
+				High = Probe;
+			}
+		}
+		else
+		{
+			Low = HintIndex + 1;
+			for (int32 Step = 1;; Step *= 2)
+			{
+				const int32 Probe = Low + Step - 1;
+				if (Probe >= NumEntries)
+				{
+					break;
+				}
+
+				++NumVisited;
+				if (Distances[Probe] >= Distance)
+				{
+					High = Probe;
+					break;
+				}
+				Low = Probe + 1;
+			}
+		}
+	}
+
+	// Binary search whatever is left of the bracket
+	int32 Index = Low;
+	if (High > Low)
+	{
+		Index += Algo::LowerBound(TArrayView<const float>(Distances.GetData() + Low, High - Low), Distance);
+		NumVisited += FMath::CeilLogTwo(High - Low + 1);
+	}
+
+	INC_DWORD_STAT_BY(STAT_DistanceMatchingSegmentsVisited, NumVisited);
+	return Index;
+}
+
+void DistanceMatching::FindTimesForDistances(TArrayView<const float> Times, TArrayView<const float> Distances, TArrayView<const float> Queries, TArrayView<float> InOutTimes, TArrayView<int32> InOutSegments)
+{
+	check(Times.Num() == Distances.Num() && Queries.Num() == InOutTimes.Num() && Queries.Num() == InOutSegments.Num());
+
+	const int32 NumEntries = Distances.Num();
+	const int32 NumQueries = Queries.Num();
+	const float* DistanceData = Distances.GetData();
+	const float* TimeData = Times.GetData();
+	int32 QueryIndex = 0;
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS
+	if (NumEntries > 0)
+	{
+		const int32 NumBatchedQueries = NumQueries & ~3;
+		INC_DWORD_STAT_BY(STAT_DistanceMatchingQueries, NumBatchedQueries);
+		INC_DWORD_STAT_BY(STAT_DistanceMatchingSegmentsVisited, NumBatchedQueries * (FMath::CeilLogTwo(NumEntries) + 1));
+
+		for (; QueryIndex + 4 <= NumQueries; QueryIndex += 4)
+		{
+			// Lower bound search for four queries in lockstep. Every lane takes the same number of steps with no branches,
+			// so the four searches overlap rather than each waiting on its own mispredicted branches. Hints are no help here, so they are not used
+			int32 Base[4] = { 0, 0, 0, 0 };
+			for (int32 Remaining = NumEntries; Remaining > 1;)
+			{
+				const int32 Half = Remaining / 2;
+				for (int32 Lane = 0; Lane < 4; ++Lane)
+				{
+					Base[Lane] += (DistanceData[Base[Lane] + Half] < Queries[QueryIndex + Lane]) ? Half : 0;
+				}
+				Remaining -= Half;
+			}
+
+			// Gather the segment around each result. An index of 0 gathers a zero length segment, which interpolates to the first time
+			int32 Index[4];
+			int32 PrevIndex[4];
+			uint32 FoundMask[4];
+			for (int32 Lane = 0; Lane < 4; ++Lane)
+			{
+				const int32 LowerBound = Base[Lane] + (DistanceData[Base[Lane]] < Queries[QueryIndex + Lane] ? 1 : 0);
+				InOutSegments[QueryIndex + Lane] = LowerBound;
+				FoundMask[Lane] = LowerBound < NumEntries ? 0xFFFFFFFF : 0;
+				Index[Lane] = FMath::Min(LowerBound, NumEntries - 1);
+				PrevIndex[Lane] = FMath::Max(Index[Lane] - 1, 0);
+			}
+
+			const VectorRegister Distance = VectorLoad(&Queries[QueryIndex]);
+			const VectorRegister PrevDistance = MakeVectorRegister(DistanceData[PrevIndex[0]], DistanceData[PrevIndex[1]], DistanceData[PrevIndex[2]], DistanceData[PrevIndex[3]]);
+			const VectorRegister NextDistance = MakeVectorRegister(DistanceData[Index[0]], DistanceData[Index[1]], DistanceData[Index[2]], DistanceData[Index[3]]);
+			const VectorRegister PrevTime = MakeVectorRegister(TimeData[PrevIndex[0]], TimeData[PrevIndex[1]], TimeData[PrevIndex[2]], TimeData[PrevIndex[3]]);
+			const VectorRegister NextTime = MakeVectorRegister(TimeData[Index[0]], TimeData[Index[1]], TimeData[Index[2]], TimeData[Index[3]]);
+
+			const VectorRegister Delta = VectorSubtract(NextDistance, PrevDistance);
+			const VectorRegister Alpha = VectorSelect(VectorCompareNE(Delta, GlobalVectorConstants::FloatZero), VectorDivide(VectorSubtract(Distance, PrevDistance), Delta), GlobalVectorConstants::FloatZero);
+			const VectorRegister Time = VectorMultiplyAdd(Alpha, VectorSubtract(NextTime, PrevTime), PrevTime);
+
+			const VectorRegister Found = MakeVectorRegister(FoundMask[0], FoundMask[1], FoundMask[2], FoundMask[3]);
+			VectorStore(VectorSelect(Found, Time, VectorLoad(&InOutTimes[QueryIndex])), &InOutTimes[QueryIndex]);
+		}
+	}
+#endif // PLATFORM_ENABLE_VECTORINTRINSICS
+
+	// Whatever is left over, or everything if there are no vector instructions. These searches can start from their hints
+	for (; QueryIndex < NumQueries; ++QueryIndex)
+	{
+		const int32 Index = FindLowerBound(Distances, Queries[QueryIndex], InOutSegments[QueryIndex]);
+		InOutSegments[QueryIndex] = Index;
+		if (Index >= NumEntries)
+		{
+			continue;
+		}
+
+		if (Index == 0)
+		{
+			InOutTimes[QueryIndex] = TimeData[0];
+			continue;
+		}
+
+		const float PrevDistance = DistanceData[Index - 1];
+		const float Delta = DistanceData[Index] - PrevDistance;
+		const float Alpha = Delta != 0.f ? (Queries[QueryIndex] - PrevDistance) / Delta : 0.f;
+		InOutTimes[QueryIndex] = TimeData[Index - 1] + Alpha * (TimeData[Index] - TimeData[Index - 1]);
+	}
+}
+
+/////////////////////////////////////////////////////
+// FDistanceMatchingTable
+
+bool FDistanceMatchingTable::FindTimeForDistance(float Distance, float& OutTime, EDistanceMatchingPrecision Precision, int32* InOutSegmentHint) const
+{
+	// First entry at or past Distance
+	const int32 Index = DistanceMatching::FindLowerBound(Distances, Distance, InOutSegmentHint ? *InOutSegmentHint : INDEX_NONE);
+	if (Index >= Distances.Num())
+	{
+		return false;
+	}
+
+	if (InOutSegmentHint)
+	{
+		*InOutSegmentHint = Index;
+	}
+
+	if (Index == 0)
+	{
+		OutTime = Times[0];
+		return true;
+	}
+
+	const float PrevDistance = Distances[Index - 1];
+	const float Delta = Distances[Index] - PrevDistance;
+	const float Alpha = Delta != 0.f ? (Distance - PrevDistance) / Delta : 0.f;
+	OutTime = Times[Index - 1] + Alpha * (Times[Index] - Times[Index - 1]);
+
+	if (Precision == EDistanceMatchingPrecision::Accurate)
+	{
+		OutTime = RefineTimeForDistance(Distance, Index - 1, Index, OutTime);
+	}
+	return true;
+}
+
+void FDistanceMatchingTable::FindTimesForDistances(TArrayView<const float> InDistances, TArrayView<float> InOutTimes, TArrayView<int32> InOutSegmentHints, EDistanceMatchingPrecision Precision) const
+{
+	DistanceMatching::FindTimesForDistances(Times, Distances, InDistances, InOutTimes, InOutSegmentHints);
+
+	if (Precision == EDistanceMatchingPrecision::Accurate)
+	{
+		// Only queries that landed between two entries have a segment to refine in
+		for (int32 QueryIndex = 0; QueryIndex < InDistances.Num(); ++QueryIndex)
+		{
+			const int32 Index = InOutSegmentHints[QueryIndex];
+			if (Index > 0 && Index < Distances.Num())
+			{
+				InOutTimes[QueryIndex] = RefineTimeForDistance(InDistances[QueryIndex], Index - 1, Index, InOutTimes[QueryIndex]);
+			}
+		}
+	}
+}
+
+float FDistanceMatchingTable::RefineTimeForDistance(float Distance, int32 PrevIndex, int32 NextIndex, float LinearTime) const
+{
+	// Regula falsi (Illinois variant) between the two keys, starting from the linear guess.
+	// This only needs curve evaluations, so it works with every interpolation mode and with weighted tangents
+	float LowTime = Times[PrevIndex];
+	float HighTime = Times[NextIndex];
+	float LowError = Curve.Eval(LowTime) - Distance;
+	float HighError = Curve.Eval(HighTime) - Distance;
+
+	// The curve overshoots or dips within the segment, so there is no bracket to solve in. Keep the linear guess
+	if (LowError > 0.f || HighError < 0.f || HighTime <= LowTime)
+	{
+		return LinearTime;
+	}
+
+	const float Tolerance = KINDA_SMALL_NUMBER * FMath::Max(1.f, FMath::Abs(Distance));
+	float Time = LinearTime;
+	int32 LastSide = 0;
+	for (int32 Iteration = 0; Iteration < MaxAccurateIterations; ++Iteration)
+	{
+		const float Error = Curve.Eval(Time) - Distance;
+		if (FMath::Abs(Error) <= Tolerance)
+		{
+			break;
+		}
+
+		// Keep the root bracketed. Halving the error at the end that did not move stops the solve from stalling on one side
+		if (Error < 0.f)
+		{
+			LowTime = Time;
+			LowError = Error;
+			if (LastSide == -1)
+			{
+				HighError *= 0.5f;
+			}
+			LastSide = -1;
+		}
+		else
+		{
+			HighTime = Time;
+			HighError = Error;
+			if (LastSide == 1)
+			{
+				LowError *= 0.5f;
+			}
+			LastSide = 1;
+		}
+
+		const float ErrorRange = HighError - LowError;
+		Time = ErrorRange > 0.f ? LowTime - LowError * (HighTime - LowTime) / ErrorRange : 0.5f * (LowTime + HighTime);
+	}
+
+	return Time;
+}
+
+const float FDistanceMatchingTable::SampleRate = 30.f;
+const int32 FDistanceMatchingTable::MaxAccurateIterations = 6;
+
+int32 FDistanceMatchingTable::GetNormalizedResolution()
+{
+	return FMath::Clamp(GDistanceMatchingNormalizedResolution, 2, 1025);
+}
+
+TSharedRef<FDistanceMatchingTable> FDistanceMatchingTable::Build(const FFloatCurve& Curve, float SequenceLength)
+{
+	TSharedRef<FDistanceMatchingTable> Table = MakeShared<FDistanceMatchingTable>();
+	Table->Curve = Curve.FloatCurve;
+	Table->BuildSearchData(SequenceLength);
+
+#if WITH_EDITOR
+	Table->SourceHash = HashCurve(Curve, SequenceLength);
+#endif
+	return Table;
+}
+
+TSharedPtr<FDistanceMatchingTable> FDistanceMatchingTable::BuildFromSequence(const UAnimSequenceBase& Sequence, SmartName::UID_Type CurveUID)
+{
+	if (!Sequence.HasCurveData(CurveUID))
+	{
+		return nullptr;
+	}
+
+	// Rebuild the curve from samples, with linear keys so that it evaluates the same as the table searches
+	TSharedRef<FDistanceMatchingTable> Table = MakeShared<FDistanceMatchingTable>();
+	const float SequenceLength = Sequence.SequenceLength;
+	const int32 NumIntervals = FMath::Max(FMath::CeilToInt(SequenceLength * SampleRate), 1);
+	Table->Curve.Keys.Reserve(NumIntervals + 1);
+	for (int32 SampleIndex = 0; SampleIndex <= NumIntervals; ++SampleIndex)
+	{
+		const float SampleTime = SequenceLength * SampleIndex / NumIntervals;
+		FRichCurveKey& Key = Table->Curve.Keys.Add_GetRef(FRichCurveKey(SampleTime, Sequence.EvaluateCurveData(CurveUID, SampleTime)));
+		Key.InterpMode = RCIM_Linear;
+	}
+	Table->BuildSearchData(SequenceLength);
+	return Table;
+}
+
+void FDistanceMatchingTable::BuildSearchData(float SequenceLength)
+{
+	const TArray<FRichCurveKey>& Keys = Curve.GetConstRefOfKeys();
+	Times.Reset(Keys.Num());
+	Distances.Reset(Keys.Num());
+
+	// Clamp each key to the furthest distance reached so far, so the table stays sorted.
+	// Searching it then gives the time at which a distance is first reached.
+	// The curve can start anywhere, e.g. approach curves that count up from a negative distance to zero, so start from the first key
+	float RunningDistance = Keys.Num() > 0 ? Keys[0].Value : 0.f;
+	for (const FRichCurveKey& Key : Keys)
+	{
+		RunningDistance = FMath::Max(RunningDistance, Key.Value);
+		Times.Add(Key.Time);
+		Distances.Add(RunningDistance);
+	}
+
+	StartDistance = Curve.Eval(0.f);
+	MaxDistance = Curve.Eval(SequenceLength);
+
+	const int32 NumNormalized = GetNormalizedResolution();
+	NormalizedDistances.Reset(NumNormalized);
+	for (int32 NormalizedIndex = 0; NormalizedIndex < NumNormalized; ++NormalizedIndex)
+	{
+		NormalizedDistances.Add(Curve.Eval(SequenceLength * NormalizedIndex / (NumNormalized - 1)));
+	}
+}
+
+/////////////////////////////////////////////////////
+// FDistanceMatchingBlendSpaceTable
+
+float FDistanceMatchingBlendSpaceTable::GetMaxError()
+{
+	return GDistanceMatchingBlendSpaceMaxError;
+}
+
+TSharedRef<FDistanceMatchingBlendSpaceTable> FDistanceMatchingBlendSpaceTable::Build(TArrayView<const TSharedPtr<const FDistanceMatchingTable>> SampleTables)
+{
+	TSharedRef<FDistanceMatchingBlendSpaceTable> Table = MakeShared<FDistanceMatchingBlendSpaceTable>();
+	Table->Resolution = FDistanceMatchingTable::GetNormalizedResolution();
+	Table->MaxError = GetMaxError();
+
+	const int32 LastIndex = Table->Resolution - 1;
+	TBitArray<> KeepKey(Table->MaxError <= 0.f, Table->Resolution);
+	KeepKey[0] = true;
+	KeepKey[LastIndex] = true;
+
+	if (Table->MaxError > 0.f)
+	{
+		// Douglas-Peucker on each sample, measuring error along the time axis, since distances are looked up to find times. On flat stretches
+		// (e.g. a plant) a tiny distance error is a large time error, so the error is how far from a key's own time the segment reaches its distance.
+		// Keys added for other samples lie on the curve and only shorten segments, and half the bound is used to leave room for that and for blends,
+		// whose times are not strictly bounded by their samples'
+		const float Tolerance = 0.5f * Table->MaxError;
+		TArray<TPair<int32, int32>, TInlineAllocator<32>> Segments;
+		for (const TSharedPtr<const FDistanceMatchingTable>& SampleTable : SampleTables)
+		{
+			if (!SampleTable.IsValid() || SampleTable->NormalizedDistances.Num() != Table->Resolution)
+			{
+				continue;
+			}
+
+			const TArray<float>& Distances = SampleTable->NormalizedDistances;
+			Segments.Add(TPair<int32, int32>(0, LastIndex));
+			while (Segments.Num() > 0)
+			{
+				const TPair<int32, int32> Segment = Segments.Pop(false);
+				const int32 First = Segment.Key;
+				const int32 Last = Segment.Value;
+
+				int32 WorstIndex = INDEX_NONE;
+				float WorstError = Tolerance;
+				const float Delta = Distances[Last] - Distances[First];
+				for (int32 Index = First + 1; Index < Last; ++Index)
+				{
+					// A segment that does not move never reaches a key that does, so that key is always kept
+					const float Offset = Distances[Index] - Distances[First];
+					const float Error = Delta != 0.f
+						? FMath::Abs((float)(First - Index) + (Last - First) * Offset / Delta) / LastIndex
+						: (Offset != 0.f ? MAX_flt : 0.f);
+					if (Error > WorstError)
+					{
+						WorstError = Error;
+						WorstIndex = Index;
+					}
+				}
+
+				if (WorstIndex != INDEX_NONE)
+				{
+					KeepKey[WorstIndex] = true;
+					Segments.Add(TPair<int32, int32>(First, WorstIndex));
+					Segments.Add(TPair<int32, int32>(WorstIndex, Last));
+				}
+			}
+		}
+	}
+
+	TArray<int32, TInlineAllocator<64>> KeyIndices;
+	for (TConstSetBitIterator<> It(KeepKey); It; ++It)
+	{
+		KeyIndices.Add(It.GetIndex());
+		Table->Times.Add((float)It.GetIndex() / LastIndex);
+	}
+
+	// Gather each sample's distances at the keys, so that blending is a weighted sum of contiguous arrays
+	Table->SampleDistances.SetNum(SampleTables.Num());
+	for (int32 SampleIndex = 0; SampleIndex < SampleTables.Num(); ++SampleIndex)
+	{
+		const TSharedPtr<const FDistanceMatchingTable>& SampleTable = SampleTables[SampleIndex];
+		if (SampleTable.IsValid() && SampleTable->NormalizedDistances.Num() == Table->Resolution)
+		{
+			TArray<float>& Distances = Table->SampleDistances[SampleIndex];
+			Distances.Reserve(KeyIndices.Num());
+			for (int32 KeyIndex : KeyIndices)
+			{
+				Distances.Add(SampleTable->NormalizedDistances[KeyIndex]);
+			}
+		}
+	}
+
+#if WITH_EDITOR
+	Table->SourceHash = HashSampleTables(SampleTables);
+#endif
+	return Table;
+}
+
+#if WITH_EDITOR
+uint32 FDistanceMatchingBlendSpaceTable::HashSampleTables(TArrayView<const TSharedPtr<const FDistanceMatchingTable>> SampleTables)
+{
+	// Hash the normalized distances the keys are picked from, rather than the tables' addresses. A table that is freed and rebuilt
+	// from an edited curve can land at the same address, and tables from BuildFromSequence have no SourceHash of their own
+	uint32 Hash = GetTypeHash(SampleTables.Num());
+	for (const TSharedPtr<const FDistanceMatchingTable>& SampleTable : SampleTables)
+	{
+		// Samples without the curve still count, so that one gaining or losing it is picked up
+		const int32 NumDistances = SampleTable.IsValid() ? SampleTable->NormalizedDistances.Num() : INDEX_NONE;
+		Hash = HashCombine(Hash, GetTypeHash(NumDistances));
+		if (SampleTable.IsValid())
+		{
+			Hash = FCrc::MemCrc32(SampleTable->NormalizedDistances.GetData(), NumDistances * sizeof(float), Hash);
+		}
+	}
+	return Hash;
+}
+#endif
+
+/////////////////////////////////////////////////////
+// FDistanceMatchingLoop
+
+float FDistanceMatchingLoop::Wrap(const FDistanceMatchingTable& Table, float Distance, bool bRelative)
+{
+	// The curve does not have to start at zero, so a cycle covers the distance between its start and its end
+	const float CycleDistance = Table.MaxDistance - Table.StartDistance;
+	if (CycleDistance <= 0.f)
+	{
+		return Distance;
+	}
+
+	int32 CyclesCrossed = 0;
+	if (Distance > Table.MaxDistance || Distance < Table.StartDistance)
+	{
+		CyclesCrossed = FMath::FloorToInt((Distance - Table.StartDistance) / CycleDistance);
+		Distance -= CyclesCrossed * CycleDistance;
+	}
+
+	// Relative distances carry on from the current cycle, absolute ones say which cycle they are in
+	CycleCount = bRelative ? CycleCount + CyclesCrossed : CyclesCrossed;
+	return Distance;
+}
+
+#if WITH_EDITOR
+uint32 FDistanceMatchingTable::HashCurve(const FFloatCurve& Curve, float SequenceLength)
+{
+	uint32 Hash = GetTypeHash(SequenceLength);
+	for (const FRichCurveKey& Key : Curve.FloatCurve.GetConstRefOfKeys())
+	{
+		Hash = HashCombine(Hash, GetTypeHash(Key.Time));
+		Hash = HashCombine(Hash, GetTypeHash(Key.Value));
+		Hash = HashCombine(Hash, GetTypeHash(Key.ArriveTangent));
+		Hash = HashCombine(Hash, GetTypeHash(Key.LeaveTangent));
+		Hash = HashCombine(Hash, GetTypeHash((uint8)Key.InterpMode));
+	}
+	return Hash;
+}
+#endif
+
+/////////////////////////////////////////////////////
+// FDistanceMatchingTableCache
+
+FRWLock FDistanceMatchingTableCache::Lock;
+TMap<FDistanceMatchingTableCache::FTableKey, FDistanceMatchingTableCache::FCachedTable<FDistanceMatchingTable>> FDistanceMatchingTableCache::Tables;
+TMap<FDistanceMatchingTableCache::FTableKey, FDistanceMatchingTableCache::FCachedTable<FDistanceMatchingBlendSpaceTable>> FDistanceMatchingTableCache::BlendSpaceTables;
+
+#if WITH_EDITOR
+FThreadSafeCounter FDistanceMatchingTableCache::EditCount;
+
+void FDistanceMatchingTableCache::NotifyAssetEdited(const UObject* Object)
+{
+	if (Object && (Object->IsA<UAnimSequenceBase>() || Object->IsA<UBlendSpaceBase>()))
+	{
+		EditCount.Increment();
+	}
+}
+
+// Curve edits do not all go through PostEditChange, so edits are counted from Modify as well
+static struct FDistanceMatchingEditNotifications
+{
+	FDistanceMatchingEditNotifications()
+	{
+		FCoreUObjectDelegates::OnObjectModified.AddStatic(&FDistanceMatchingTableCache::NotifyAssetEdited);
+		FCoreUObjectDelegates::OnObjectPropertyChanged.AddLambda([](UObject* Object, FPropertyChangedEvent&) { FDistanceMatchingTableCache::NotifyAssetEdited(Object); });
+	}
+} GDistanceMatchingEditNotifications;
+#endif
+
+TSharedPtr<const FDistanceMatchingTable> FDistanceMatchingTableCache::FindOrBuild(const UAnimSequenceBase* Sequence, FName CurveName, SmartName::UID_Type CurveUID)
+{
+	if (Sequence == nullptr || CurveUID == SmartName::MaxUID)
+	{
+		return nullptr;
+	}
+
+	const FFloatCurve* Curve = static_cast<const FFloatCurve*>(Sequence->GetCurveData().GetCurveData(CurveUID));
+	const FTableKey Key(FObjectKey(Sequence), CurveName);
+
+#if WITH_EDITOR
+	// Read before checking, so that an edit made while checking is picked up by the next lookup
+	const int32 CurrentEditCount = GetEditCount();
+	TSharedPtr<const FDistanceMatchingTable> FoundTable;
+#endif
+
+	{
+		FRWScopeLock ReadLock(Lock, SLT_ReadOnly);
+		if (const FCachedTable<FDistanceMatchingTable>* CachedTable = Tables.Find(Key))
+		{
+#if WITH_EDITOR
+			if (CachedTable->CheckedEditCount == CurrentEditCount)
+#endif
+			{
+				return CachedTable->Table;
+			}
+#if WITH_EDITOR
+			FoundTable = CachedTable->Table;
+#endif
+		}
+	}
+
+#if WITH_EDITOR
+	// Something has been edited since the table was last checked. Unless it was this curve, the table is kept
+	if (FoundTable.IsValid() && (Curve == nullptr || FoundTable->SourceHash == FDistanceMatchingTable::HashCurve(*Curve, Sequence->SequenceLength)))
+	{
+		FRWScopeLock WriteLock(Lock, SLT_Write);
+		FCachedTable<FDistanceMatchingTable>* CachedTable = Tables.Find(Key);
+		if (CachedTable && CachedTable->Table == FoundTable)
+		{
+			CachedTable->CheckedEditCount = CurrentEditCount;
+		}
+		return FoundTable;
+	}
+#endif
+
+	// Build outside of the lock. If another thread gets there first, both tables are identical and the last one in is kept.
+	// Without the raw curve, fall back to sampling whatever curve data the sequence does have
+	TSharedPtr<const FDistanceMatchingTable> Table = Curve ? FDistanceMatchingTable::Build(*Curve, Sequence->SequenceLength) : FDistanceMatchingTable::BuildFromSequence(*Sequence, CurveUID);
+	if (!Table.IsValid())
+	{
+		return nullptr;
+	}
+
+	FRWScopeLock WriteLock(Lock, SLT_Write);
+
+	// Tables are only added here, so this is the place to drop any for sequences that have been unloaded
+	for (auto It = Tables.CreateIterator(); It; ++It)
+	{
+		if (It.Key().Key.ResolveObjectPtr() == nullptr)
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	FCachedTable<FDistanceMatchingTable>& CachedTable = Tables.Add(Key);
+	CachedTable.Table = Table;
+#if WITH_EDITOR
+	CachedTable.CheckedEditCount = CurrentEditCount;
+#endif
+	return Table;
+}
+
+TSharedPtr<const FDistanceMatchingBlendSpaceTable> FDistanceMatchingTableCache::FindOrBuildBlendSpace(const UBlendSpaceBase* BlendSpace, FName CurveName, SmartName::UID_Type CurveUID)
+{
+	if (BlendSpace == nullptr || CurveUID == SmartName::MaxUID)
+	{
+		return nullptr;
+	}
+
+	const FTableKey Key(FObjectKey(BlendSpace), CurveName);
+
+#if WITH_EDITOR
+	const int32 CurrentEditCount = GetEditCount();
+	TSharedPtr<const FDistanceMatchingBlendSpaceTable> FoundTable;
+#endif
+
+	{
+		FRWScopeLock ReadLock(Lock, SLT_ReadOnly);
+		if (const FCachedTable<FDistanceMatchingBlendSpaceTable>* CachedTable = BlendSpaceTables.Find(Key))
+		{
+			if (CachedTable->Table->Resolution == FDistanceMatchingTable::GetNormalizedResolution() && CachedTable->Table->MaxError == FDistanceMatchingBlendSpaceTable::GetMaxError())
+			{
+#if WITH_EDITOR
+				if (CachedTable->CheckedEditCount == CurrentEditCount)
+#endif
+				{
+					return CachedTable->Table;
+				}
+#if WITH_EDITOR
+				FoundTable = CachedTable->Table;
+#endif
+			}
+		}
+	}
+
+	TArray<TSharedPtr<const FDistanceMatchingTable>, TInlineAllocator<16>> SampleTables;
+	for (const FBlendSample& Sample : BlendSpace->GetBlendSamples())
+	{
+		SampleTables.Add(FindOrBuild(Sample.Animation, CurveName, CurveUID));
+	}
+
+#if WITH_EDITOR
+	// Something has been edited since the table was last checked. Unless it was the blend space or one of its samples, the table is kept
+	if (FoundTable.IsValid() && FoundTable->SourceHash == FDistanceMatchingBlendSpaceTable::HashSampleTables(SampleTables))
+	{
+		FRWScopeLock WriteLock(Lock, SLT_Write);
+		FCachedTable<FDistanceMatchingBlendSpaceTable>* CachedTable = BlendSpaceTables.Find(Key);
+		if (CachedTable && CachedTable->Table == FoundTable)
+		{
+			CachedTable->CheckedEditCount = CurrentEditCount;
+		}
+		return FoundTable;
+	}
+#endif
+
+	// Build outside of the lock, as with sequence tables
+	TSharedPtr<const FDistanceMatchingBlendSpaceTable> Table = FDistanceMatchingBlendSpaceTable::Build(SampleTables);
+
+	FRWScopeLock WriteLock(Lock, SLT_Write);
+
+	for (auto It = BlendSpaceTables.CreateIterator(); It; ++It)
+	{
+		if (It.Key().Key.ResolveObjectPtr() == nullptr)
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	FCachedTable<FDistanceMatchingBlendSpaceTable>& CachedTable = BlendSpaceTables.Add(Key);
+	CachedTable.Table = Table;
+#if WITH_EDITOR
+	CachedTable.CheckedEditCount = CurrentEditCount;
+#endif
+	return Table;
+}
+
+void FDistanceMatchingTableCache::Reset()
+{
+	FRWScopeLock WriteLock(Lock, SLT_Write);
+	Tables.Reset();
+	BlendSpaceTables.Reset();
+}
+//~Charlie
@@ -0,0 +1,223 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+//Charlie - Distance Matching implementation
+// Shared data used by the distance matching evaluator nodes
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Animation/SmartName.h"
+#include "Misc/ScopeRWLock.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "UObject/ObjectKey.h"
+#include "Curves/RichCurve.h"
+#include "AnimDistanceMatching.generated.h"
+
+class UAnimSequenceBase;
+class UBlendSpaceBase;
+class USkeleton;
+struct FFloatCurve;
+
+UENUM(BlueprintType)
+enum class EDistanceMatchingPrecision : uint8
+{
+	/** Interpolate linearly between curve keys. Cheapest, but slides between keys on curved segments unless the curve is densely keyed */
+	Fast,
+	/** Solve against the curve itself, tangents included, with a few refinement iterations */
+	Accurate,
+};
+
+namespace DistanceMatching
+{
+	/** Resolve the UID of a distance curve on Skeleton. Returns SmartName::MaxUID if there is no such curve */
+	ANIMGRAPHRUNTIME_API SmartName::UID_Type ResolveCurveUID(const USkeleton* Skeleton, FName CurveName);
+
+	/**
+	 * Index of the first of Distances at or past Distance, or Distances.Num() if there is none. Distances must never decrease.
+	 * If HintIndex is valid, the search gallops outwards from it, so small moves from the last answer are found in one or two steps
+	 */
+	ANIMGRAPHRUNTIME_API int32 FindLowerBound(TArrayView<const float> Distances, float Distance, int32 HintIndex = INDEX_NONE);
+
+	/**
+	 * Times at which Distances first reach each of Queries, interpolating linearly between entries. Distances must never decrease, and Times must be the same size.
+	 * Queries are solved four at a time with vector instructions where available. Any left over, or all of them without vector instructions, are solved one at a time.
+	 * InOutSegments holds a hint for each query on entry (see FindLowerBound), and the first entry at or past the query on return, or Distances.Num() if there is none.
+	 * The time of a query beyond the last entry is left as it was
+	 */
+	ANIMGRAPHRUNTIME_API void FindTimesForDistances(TArrayView<const float> Times, TArrayView<const float> Distances, TArrayView<const float> Queries, TArrayView<float> InOutTimes, TArrayView<int32> InOutSegments);
+
+	/** InOutValues[i] += Values[i] * Weight, using vector instructions where available. The views must be the same size */
+	ANIMGRAPHRUNTIME_API void AddWeighted(TArrayView<float> InOutValues, TArrayView<const float> Values, float Weight);
+}
+
+/** A distance curve baked into a monotonic distance to time table, so distances can be matched with a binary search instead of a walk over the curve keys */
+struct ANIMGRAPHRUNTIME_API FDistanceMatchingTable
+{
+	/** Key times of the curve */
+	TArray<float> Times;
+
+	/** Distance at each of Times. Never decreases, so it can be searched */
+	TArray<float> Distances;
+
+	/** Distance at the start of the sequence */
+	float StartDistance = 0.f;
+
+	/** Distance at the end of the sequence */
+	float MaxDistance = 0.f;
+
+	/** Copy of the source curve, for evaluating distance from time */
+	FRichCurve Curve;
+
+	/**
+	 * Distance at GetNormalizedResolution() evenly spaced times, from the start of the sequence to its end.
+	 * Tables for sequences of any length line up with each other, so blend space samples can be blended as plain arrays
+	 */
+	TArray<float> NormalizedDistances;
+
+#if WITH_EDITOR
+	/** Hash of the keys the table was built from, so that edits to the curve are picked up */
+	uint32 SourceHash = 0;
+#endif
+
+	/** Rate at which curves are sampled by BuildFromSequence */
+	static const float SampleRate;
+
+	/** Most refinement iterations per query in EDistanceMatchingPrecision::Accurate. Each one evaluates the curve once, on top of the two evaluations that bracket the segment */
+	static const int32 MaxAccurateIterations;
+
+	/** Number of entries in NormalizedDistances, set with a.DistanceMatching.NormalizedResolution */
+	static int32 GetNormalizedResolution();
+
+	/**
+	 * Find the time at which the curve first reaches Distance.
+	 * Returns false if Distance is beyond the last key.
+	 * InOutSegmentHint, if given, should hold the segment returned by the previous query for the same caller (or INDEX_NONE).
+	 * The search then starts from there, which finds the answer in one or two steps while the distance moves smoothly
+	 */
+	bool FindTimeForDistance(float Distance, float& OutTime, EDistanceMatchingPrecision Precision = EDistanceMatchingPrecision::Fast, int32* InOutSegmentHint = nullptr) const;
+
+	/**
+	 * FindTimeForDistance for many distances at once, e.g. for every character using the same locomotion sequence (see DistanceMatching::FindTimesForDistances).
+	 * InOutTimes holds the time to keep for each query whose distance is beyond the last key. InOutSegmentHints holds a segment hint for each query, which is updated even when the distance is beyond the last key (to the number of keys)
+	 */
+	void FindTimesForDistances(TArrayView<const float> InDistances, TArrayView<float> InOutTimes, TArrayView<int32> InOutSegmentHints, EDistanceMatchingPrecision Precision = EDistanceMatchingPrecision::Fast) const;
+
+	/** Distance travelled at Time */
+	float GetDistanceForTime(float Time) const { return Curve.Eval(Time); }
+
+	/** Bake Curve into a table */
+	static TSharedRef<FDistanceMatchingTable> Build(const FFloatCurve& Curve, float SequenceLength);
+
+	/**
+	 * Bake a table by sampling the curve through the sequence, for when the raw curve is not available (e.g. it has been stripped from a cooked build).
+	 * Returns null if the sequence does not have the curve
+	 */
+	static TSharedPtr<FDistanceMatchingTable> BuildFromSequence(const UAnimSequenceBase& Sequence, SmartName::UID_Type CurveUID);
+
+#if WITH_EDITOR
+	static uint32 HashCurve(const FFloatCurve& Curve, float SequenceLength);
+#endif
+
+private:
+	/** Build Times, Distances, NormalizedDistances and the start and end distances from Curve */
+	void BuildSearchData(float SequenceLength);
+
+	/** Refine a linearly interpolated time between two table entries against the curve itself */
+	float RefineTimeForDistance(float Distance, int32 PrevIndex, int32 NextIndex, float LinearTime) const;
+};
+
+/**
+ * The normalized distance tables of a blend space's samples, cut down to the fewest keys that keep each sample's distance to time lookups within a.DistanceMatching.BlendSpaceMaxError of the full tables.
+ * Keys are picked for every sample at once, so they are shared by any weighted blend of the samples
+ */
+struct ANIMGRAPHRUNTIME_API FDistanceMatchingBlendSpaceTable
+{
+	/** Normalized times of the keys. Always starts at 0 and ends at 1 */
+	TArray<float> Times;
+
+	/** Distance at each of Times for each of the blend space's samples, by sample index. Empty for samples without the curve */
+	TArray<TArray<float>> SampleDistances;
+
+	/** Normalized table resolution and error bound that the keys were picked with */
+	int32 Resolution = 0;
+	float MaxError = 0.f;
+
+#if WITH_EDITOR
+	/** Hash of the sample distances the keys were picked from, so that edits to any of them are picked up */
+	uint32 SourceHash = 0;
+#endif
+
+	/** Largest error in normalized time allowed between keys, set with a.DistanceMatching.BlendSpaceMaxError. Zero or less keeps every key */
+	static float GetMaxError();
+
+	/** Pick the keys for a blend space with one table per sample (null for samples without the curve) */
+	static TSharedRef<FDistanceMatchingBlendSpaceTable> Build(TArrayView<const TSharedPtr<const FDistanceMatchingTable>> SampleTables);
+
+#if WITH_EDITOR
+	static uint32 HashSampleTables(TArrayView<const TSharedPtr<const FDistanceMatchingTable>> SampleTables);
+#endif
+};
+
+/** Tracks distance travelled through a looping distance curve */
+struct ANIMGRAPHRUNTIME_API FDistanceMatchingLoop
+{
+	/** Whole cycles of the curve travelled. Negative when travelling backwards past the start */
+	int32 CycleCount = 0;
+
+	/**
+	 * Wrap Distance into a single cycle of Table, i.e. between its start and end distances, and update CycleCount.
+	 * If bRelative, Distance is measured in the current cycle (previous distance plus a delta). Otherwise it is measured from the start of the first cycle.
+	 * Distances already within the cycle are returned as they are
+	 */
+	float Wrap(const FDistanceMatchingTable& Table, float Distance, bool bRelative);
+
+	void Reset() { CycleCount = 0; }
+};
+
+/** Distance matching tables shared by every node matching the same curve on the same sequence. Safe to use from worker threads */
+class ANIMGRAPHRUNTIME_API FDistanceMatchingTableCache
+{
+public:
+	/** Find the table for CurveName on Sequence, building it on first use. Returns null if the sequence does not have the curve */
+	static TSharedPtr<const FDistanceMatchingTable> FindOrBuild(const UAnimSequenceBase* Sequence, FName CurveName, SmartName::UID_Type CurveUID);
+
+	/** Find the key layout for CurveName on the samples of BlendSpace, building it on first use */
+	static TSharedPtr<const FDistanceMatchingBlendSpaceTable> FindOrBuildBlendSpace(const UBlendSpaceBase* BlendSpace, FName CurveName, SmartName::UID_Type CurveUID);
+
+	/** Release all tables. Nodes holding on to a table keep it alive */
+	static void Reset();
+
+#if WITH_EDITOR
+	/**
+	 * Number of edits made to sequences and blend spaces so far. Tables are only checked against their source again once this has changed,
+	 * so a node can keep the table it has until then
+	 */
+	static int32 GetEditCount() { return EditCount.GetValue(); }
+
+	/** Count an edit to Object if it is an asset that tables are built from */
+	static void NotifyAssetEdited(const UObject* Object);
+#endif
+
+private:
+	typedef TPair<FObjectKey, FName> FTableKey;
+
+	template<typename TableType>
+	struct FCachedTable
+	{
+		TSharedPtr<const TableType> Table;
+
+#if WITH_EDITOR
+		/** Edit count when the table was last checked against its source */
+		int32 CheckedEditCount = 0;
+#endif
+	};
+
+	static FRWLock Lock;
+	static TMap<FTableKey, FCachedTable<FDistanceMatchingTable>> Tables;
+	static TMap<FTableKey, FCachedTable<FDistanceMatchingBlendSpaceTable>> BlendSpaceTables;
+
+#if WITH_EDITOR
+	static FThreadSafeCounter EditCount;
+#endif
+};
+//~Charlie
@@ -0,0 +1,466 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+//Charlie - Distance Matching implementation
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "HAL/MemoryBase.h"
+#include "HAL/PlatformTLS.h"
+#include "Algo/BinarySearch.h"
+#include "UObject/Package.h"
+#include "Animation/AnimCurveTypes.h"
+#include "Animation/AnimSequence.h"
+#include "AnimNodes/AnimDistanceMatching.h"
+#include "AnimNodes/AnimNode_SequenceEvaluator.h"
+#include "AnimNodes/AnimNode_BlendSpaceEvaluator.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace DistanceMatchingTests
+{
+	struct FTestKey
+	{
+		float Time;
+		float Distance;
+	};
+
+	/** Curve with linear keys at the given times and distances */
+	static FFloatCurve MakeCurve(const TArray<FTestKey>& Keys)
+	{
+		FFloatCurve Curve;
+		for (const FTestKey& Key : Keys)
+		{
+			Curve.FloatCurve.AddKey(Key.Time, Key.Distance);
+		}
+		return Curve;
+	}
+
+	/** The key walk that the sequence evaluator used before distance tables. Returns false if no key reaches Distance */
+	static bool FindTimeByKeyWalk(const FFloatCurve& Curve, float Distance, float& OutTime)
+	{
+		FRichCurveKey PrevKey;
+		for (const FRichCurveKey& Key : Curve.FloatCurve.GetConstRefOfKeys())
+		{
+			if (Key.Value >= Distance)
+			{
+				const float Delta = Key.Value - PrevKey.Value;
+				const float Alpha = Delta != 0.f ? (Distance - PrevKey.Value) / Delta : 0.f;
+				OutTime = PrevKey.Time + Alpha * (Key.Time - PrevKey.Time);
+				return true;
+			}
+			PrevKey = Key;
+		}
+		return false;
+	}
+
+	/** Check the table against the key walk at each of Distances */
+	static void TestAgainstKeyWalk(FAutomationTestBase& Test, const TCHAR* CurveName, const FFloatCurve& Curve, float SequenceLength, const TArray<float>& Distances)
+	{
+		const TSharedRef<FDistanceMatchingTable> Table = FDistanceMatchingTable::Build(Curve, SequenceLength);
+		for (float Distance : Distances)
+		{
+			float ExpectedTime = -1.f;
+			const bool bExpectedFound = FindTimeByKeyWalk(Curve, Distance, ExpectedTime);
+
+			float Time = -1.f;
+			const bool bFound = Table->FindTimeForDistance(Distance, Time);
+
+			const FString What = FString::Printf(TEXT("%s at distance %.3f"), CurveName, Distance);
+			Test.TestEqual(What + TEXT(" found"), bFound, bExpectedFound);
+			if (bFound && bExpectedFound)
+			{
+				Test.TestEqual(What, Time, ExpectedTime, KINDA_SMALL_NUMBER);
+			}
+		}
+	}
+
+	/** Wrap Distance and check the distance and cycle count that come out */
+	static void TestWrap(FAutomationTestBase& Test, const TCHAR* What, FDistanceMatchingLoop& Loop, const FDistanceMatchingTable& Table, float Distance, bool bRelative, float ExpectedDistance, int32 ExpectedCycleCount)
+	{
+		const float WrappedDistance = Loop.Wrap(Table, Distance, bRelative);
+		Test.TestEqual(FString::Printf(TEXT("%s distance"), What), WrappedDistance, ExpectedDistance, KINDA_SMALL_NUMBER);
+		Test.TestEqual(FString::Printf(TEXT("%s cycle count"), What), Loop.CycleCount, ExpectedCycleCount);
+	}
+
+	/**
+	 * Counts the heap allocations made by the thread that installs it, passing every call on to the allocator it stands in for.
+	 * It is never destroyed, as other threads can still be inside it for a moment after it has been uninstalled
+	 */
+	class FAllocationCounter : public FMalloc
+	{
+	public:
+		static FAllocationCounter& Get()
+		{
+			static FAllocationCounter Counter;
+			return Counter;
+		}
+
+		void Install()
+		{
+			check(GMalloc != this);
+			Inner = GMalloc;
+			ThreadId = FPlatformTLS::GetCurrentThreadId();
+			NumAllocations = 0;
+			GMalloc = this;
+		}
+
+		/** Put the previous allocator back, and return the number of allocations made since Install */
+		int32 Uninstall()
+		{
+			check(GMalloc == this);
+			GMalloc = Inner;
+			return NumAllocations;
+		}
+
+		// FMalloc interface
+		virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+		{
+			CountAllocation();
+			return Inner->Malloc(Count, Alignment);
+		}
+		virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			// Reallocating to nothing is a free
+			if (Count > 0)
+			{
+				CountAllocation();
+			}
+			return Inner->Realloc(Original, Count, Alignment);
+		}
+		virtual void Free(void* Original) override { Inner->Free(Original); }
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return Inner->QuantizeSize(Count, Alignment); }
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+		virtual void Trim(bool bTrimThreadCaches) override { Inner->Trim(bTrimThreadCaches); }
+		virtual void SetupTLSCachesOnCurrentThread() override { Inner->SetupTLSCachesOnCurrentThread(); }
+		virtual void ClearAndDisableTLSCachesOnCurrentThread() override { Inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+		virtual void InitializeStatsMetadata() override { Inner->InitializeStatsMetadata(); }
+		virtual void UpdateStats() override { Inner->UpdateStats(); }
+		virtual void GetAllocatorStats(FGenericMemoryStats& OutStats) override { Inner->GetAllocatorStats(OutStats); }
+		virtual void DumpAllocatorStats(FOutputDevice& Ar) override { Inner->DumpAllocatorStats(Ar); }
+		virtual bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+		virtual bool ValidateHeap() override { return Inner->ValidateHeap(); }
+		virtual const TCHAR* GetDescriptiveName() override { return Inner->GetDescriptiveName(); }
+		// End of FMalloc interface
+
+	private:
+		void CountAllocation()
+		{
+			if (FPlatformTLS::GetCurrentThreadId() == ThreadId)
+			{
+				++NumAllocations;
+			}
+		}
+
+		FMalloc* Inner = nullptr;
+		uint32 ThreadId = 0;
+		int32 NumAllocations = 0;
+	};
+
+	/** Sequence evaluator with its distance matching state set up directly, so its per-update solve runs without an anim instance */
+	struct FTestSequenceEvaluator : public FAnimNode_SequenceEvaluator
+	{
+		void SetDistanceTable(UAnimSequenceBase* InSequence, const TSharedPtr<const FDistanceMatchingTable>& InTable)
+		{
+			Sequence = InSequence;
+			bShouldUseExplicityTimeAsDistanceCurveLookup = true;
+			DistanceCurveSequence = InSequence;
+			DistanceTable = InTable;
+			bDistanceCurveDirty = false;
+		}
+
+		using FAnimNode_SequenceEvaluator::MatchDistance;
+	};
+
+	/** Blend space evaluator that blends its distance curve straight from a key layout, so its per-update solve runs without an anim instance */
+	struct FTestBlendSpaceEvaluator : public FAnimNode_BlendSpaceEvaluator
+	{
+		/** Blend the first two samples of Table, as BuildBlendedDistanceCurve does once the blend space table has been found */
+		void Blend(const FDistanceMatchingBlendSpaceTable& Table, float Alpha)
+		{
+			BlendedDistanceTimes.Reset();
+			BlendedDistanceTimes.Append(Table.Times);
+			BlendedDistances.SetNumZeroed(Table.Times.Num(), false);
+			DistanceMatching::AddWeighted(BlendedDistances, Table.SampleDistances[0], 1.f - Alpha);
+			DistanceMatching::AddWeighted(BlendedDistances, Table.SampleDistances[1], Alpha);
+			BuildBlendedDistanceRuns();
+		}
+
+		using FAnimNode_BlendSpaceEvaluator::MatchBlendedDistance;
+	};
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDistanceMatchingTableTest, "System.Engine.Animation.DistanceMatching.Table", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FDistanceMatchingTableTest::RunTest(const FString& Parameters)
+{
+	using namespace DistanceMatchingTests;
+
+	// Rising curve, e.g. a start or run cycle
+	TestAgainstKeyWalk(*this, TEXT("Rising"), MakeCurve({ { 0.f, 0.f }, { 0.5f, 40.f }, { 1.f, 150.f }, { 2.f, 300.f } }), 2.f,
+		{ 0.f, 1.f, 20.f, 40.f, 100.f, 150.f, 299.f, 300.f, 301.f });
+
+	// Curve entirely below zero, e.g. a stop or approach counting up to the target
+	TestAgainstKeyWalk(*this, TEXT("Negative"), MakeCurve({ { 0.f, -200.f }, { 1.f, 0.f } }), 1.f,
+		{ -200.f, -150.f, -100.f, -50.f, -1.f, 0.f, 1.f });
+
+	// Flat segments, e.g. a plant partway through
+	TestAgainstKeyWalk(*this, TEXT("Flat"), MakeCurve({ { 0.f, 0.f }, { 1.f, 100.f }, { 2.f, 100.f }, { 3.f, 200.f } }), 3.f,
+		{ 0.f, 50.f, 100.f, 100.001f, 150.f, 200.f });
+
+	// The values from the negative curve that a table starting at zero used to get wrong
+	const TSharedRef<FDistanceMatchingTable> Table = FDistanceMatchingTable::Build(MakeCurve({ { 0.f, -200.f }, { 1.f, 0.f } }), 1.f);
+	float Time = 0.f;
+	Table->FindTimeForDistance(-100.f, Time);
+	TestEqual(TEXT("Negative curve half way"), Time, 0.5f, KINDA_SMALL_NUMBER);
+	Table->FindTimeForDistance(-1.f, Time);
+	TestEqual(TEXT("Negative curve near the end"), Time, 0.995f, KINDA_SMALL_NUMBER);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDistanceMatchingLoopTest, "System.Engine.Animation.DistanceMatching.Loop", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FDistanceMatchingLoopTest::RunTest(const FString& Parameters)
+{
+	using namespace DistanceMatchingTests;
+
+	// A cycle that does not start at zero, running from 100 to 300
+	const TSharedRef<FDistanceMatchingTable> Table = FDistanceMatchingTable::Build(MakeCurve({ { 0.f, 100.f }, { 1.f, 300.f } }), 1.f);
+
+	// Relative distances carry the count on from the current cycle
+	{
+		FDistanceMatchingLoop Loop;
+		TestWrap(*this, TEXT("Relative within the cycle"), Loop, *Table, 250.f, true, 250.f, 0);
+		TestWrap(*this, TEXT("Relative at the end of the cycle"), Loop, *Table, 300.f, true, 300.f, 0);
+		TestWrap(*this, TEXT("Relative forward one cycle"), Loop, *Table, 350.f, true, 150.f, 1);
+		TestWrap(*this, TEXT("Relative forward several cycles"), Loop, *Table, 750.f, true, 150.f, 4);
+		TestWrap(*this, TEXT("Relative backward one cycle"), Loop, *Table, 50.f, true, 250.f, 3);
+		TestWrap(*this, TEXT("Relative backward several cycles"), Loop, *Table, -350.f, true, 250.f, 0);
+	}
+
+	// Absolute distances say which cycle they are in, whatever the count was before
+	{
+		FDistanceMatchingLoop Loop;
+		TestWrap(*this, TEXT("Absolute forward several cycles"), Loop, *Table, 750.f, false, 150.f, 3);
+		TestWrap(*this, TEXT("Absolute repeated"), Loop, *Table, 750.f, false, 150.f, 3);
+		TestWrap(*this, TEXT("Absolute within the first cycle"), Loop, *Table, 250.f, false, 250.f, 0);
+		TestWrap(*this, TEXT("Absolute backward several cycles"), Loop, *Table, -350.f, false, 250.f, -3);
+	}
+
+	// A curve that does not move has no cycle to wrap in
+	{
+		const TSharedRef<FDistanceMatchingTable> FlatTable = FDistanceMatchingTable::Build(MakeCurve({ { 0.f, 100.f }, { 1.f, 100.f } }), 1.f);
+		FDistanceMatchingLoop Loop;
+		TestWrap(*this, TEXT("Flat curve"), Loop, *FlatTable, 350.f, true, 350.f, 0);
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDistanceMatchingBlendSpaceKeysTest, "System.Engine.Animation.DistanceMatching.BlendSpaceKeys", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FDistanceMatchingBlendSpaceKeysTest::RunTest(const FString& Parameters)
+{
+	using namespace DistanceMatchingTests;
+
+	// A start that creeps through a plant, where dropping keys costs little distance but a lot of time
+	TArray<TSharedPtr<const FDistanceMatchingTable>> SampleTables;
+	SampleTables.Add(FDistanceMatchingTable::Build(MakeCurve({ { 0.f, 0.f }, { 0.4f, 100.f }, { 0.5f, 100.4f }, { 0.6f, 100.5f }, { 1.f, 200.f } }), 1.f));
+	const TSharedRef<FDistanceMatchingBlendSpaceTable> Table = FDistanceMatchingBlendSpaceTable::Build(SampleTables);
+
+	// Every full resolution entry should be found within the error bound of its own time
+	const TArray<float>& FullDistances = SampleTables[0]->NormalizedDistances;
+	const int32 LastIndex = FullDistances.Num() - 1;
+	for (int32 Index = 0; Index <= LastIndex; ++Index)
+	{
+		float Time = -1.f;
+		int32 Segment = INDEX_NONE;
+		DistanceMatching::FindTimesForDistances(Table->Times, Table->SampleDistances[0], MakeArrayView(&FullDistances[Index], 1), MakeArrayView(&Time, 1), MakeArrayView(&Segment, 1));
+
+		const float ExpectedTime = (float)Index / LastIndex;
+		TestTrue(FString::Printf(TEXT("Time at distance %.3f is %.4f, expected %.4f within %.4f"), FullDistances[Index], Time, ExpectedTime, Table->MaxError),
+			FMath::Abs(Time - ExpectedTime) <= Table->MaxError + KINDA_SMALL_NUMBER);
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDistanceMatchingAllocationTest, "System.Engine.Animation.DistanceMatching.SteadyStateAllocations", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FDistanceMatchingAllocationTest::RunTest(const FString& Parameters)
+{
+	using namespace DistanceMatchingTests;
+
+	const int32 NumWarmUpUpdates = 100;
+	const int32 NumUpdates = 10000;
+	const float DeltaTime = 1.f / 30.f;
+
+	// A looping run cycle matched by speed, refined against the curve
+	UAnimSequence* Sequence = NewObject<UAnimSequence>(GetTransientPackage());
+	Sequence->SequenceLength = 1.f;
+	const TSharedPtr<const FDistanceMatchingTable> Table = FDistanceMatchingTable::Build(MakeCurve({ { 0.f, 0.f }, { 0.25f, 60.f }, { 0.5f, 100.f }, { 1.f, 200.f } }), 1.f);
+
+	FTestSequenceEvaluator SequenceEvaluator;
+	SequenceEvaluator.SetDistanceTable(Sequence, Table);
+	SequenceEvaluator.bShouldLoop = true;
+	SequenceEvaluator.bDistanceCurveInputIsSpeed = true;
+	SequenceEvaluator.DistanceMatchingPrecision = EDistanceMatchingPrecision::Accurate;
+	SequenceEvaluator.ExplicitTime = 300.f;
+
+	// A looping blend between a run and a stop that turns around, matched by delta distance
+	TArray<TSharedPtr<const FDistanceMatchingTable>> SampleTables;
+	SampleTables.Add(FDistanceMatchingTable::Build(MakeCurve({ { 0.f, 0.f }, { 1.f, 200.f } }), 1.f));
+	SampleTables.Add(FDistanceMatchingTable::Build(MakeCurve({ { 0.f, 0.f }, { 0.5f, 120.f }, { 0.75f, 100.f }, { 1.f, 100.f } }), 1.f));
+	const TSharedRef<FDistanceMatchingBlendSpaceTable> BlendSpaceTable = FDistanceMatchingBlendSpaceTable::Build(SampleTables);
+
+	FTestBlendSpaceEvaluator BlendSpaceEvaluator;
+	BlendSpaceEvaluator.bUseDeltaDistance = true;
+	BlendSpaceEvaluator.bLoop = true;
+
+	int32 CyclesCrossed = 0;
+	float BlendSpaceTime = 0.f;
+	auto Update = [&](int32 UpdateIndex)
+	{
+		SequenceEvaluator.MatchDistance(DeltaTime, false, CyclesCrossed);
+
+		// The blend input keeps moving, so the blended curve is built again every update
+		BlendSpaceEvaluator.Blend(*BlendSpaceTable, 0.5f + 0.5f * FMath::Sin(UpdateIndex * 0.01f));
+		BlendSpaceTime = BlendSpaceEvaluator.MatchBlendedDistance(5.f, BlendSpaceTime);
+	};
+
+	// The first updates size the node's buffers. After that nothing should be allocated
+	for (int32 UpdateIndex = 0; UpdateIndex < NumWarmUpUpdates; ++UpdateIndex)
+	{
+		Update(UpdateIndex);
+	}
+
+	FAllocationCounter& AllocationCounter = FAllocationCounter::Get();
+	AllocationCounter.Install();
+	for (int32 UpdateIndex = NumWarmUpUpdates; UpdateIndex < NumWarmUpUpdates + NumUpdates; ++UpdateIndex)
+	{
+		Update(UpdateIndex);
+	}
+	const int32 NumAllocations = AllocationCounter.Uninstall();
+
+	TestEqual(FString::Printf(TEXT("Heap allocations over %d steady state updates"), NumUpdates), NumAllocations, 0);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDistanceMatchingBatchTest, "System.Engine.Animation.DistanceMatching.Batch", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FDistanceMatchingBatchTest::RunTest(const FString& Parameters)
+{
+	using namespace DistanceMatchingTests;
+
+	// A stop that starts below zero and plants partway through, queried from before its start to beyond its end
+	const TSharedRef<FDistanceMatchingTable> Table = FDistanceMatchingTable::Build(MakeCurve({ { 0.f, -50.f }, { 0.5f, 40.f }, { 1.f, 100.f }, { 1.5f, 100.f }, { 2.f, 300.f } }), 2.f);
+	FRandomStream Random(1234);
+
+	// Every batch size up to two full vector batches and a few left over, so both the vector and scalar paths are covered
+	for (int32 BatchSize = 1; BatchSize <= 11; ++BatchSize)
+	{
+		for (EDistanceMatchingPrecision Precision : { EDistanceMatchingPrecision::Fast, EDistanceMatchingPrecision::Accurate })
+		{
+			TArray<float> Distances;
+			TArray<float> Times;
+			TArray<int32> SegmentHints;
+			for (int32 QueryIndex = 0; QueryIndex < BatchSize; ++QueryIndex)
+			{
+				Distances.Add(Random.FRandRange(-60.f, 320.f));
+				Times.Add(-1.f);
+				SegmentHints.Add(QueryIndex % 2 ? Random.RandRange(0, 10) : INDEX_NONE);
+			}
+			Table->FindTimesForDistances(Distances, Times, SegmentHints, Precision);
+
+			for (int32 QueryIndex = 0; QueryIndex < BatchSize; ++QueryIndex)
+			{
+				float ExpectedTime = -1.f;
+				Table->FindTimeForDistance(Distances[QueryIndex], ExpectedTime, Precision);
+
+				const FString What = FString::Printf(TEXT("Batch of %d, %s, distance %.3f"), BatchSize, Precision == EDistanceMatchingPrecision::Fast ? TEXT("fast") : TEXT("accurate"), Distances[QueryIndex]);
+				TestEqual(What, Times[QueryIndex], ExpectedTime, KINDA_SMALL_NUMBER);
+				TestEqual(What + TEXT(" segment"), SegmentHints[QueryIndex], (int32)Algo::LowerBound(Table->Distances, Distances[QueryIndex]));
+			}
+		}
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDistanceMatchingBatchPerfTest, "System.Engine.Animation.DistanceMatching.BatchPerf", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FDistanceMatchingBatchPerfTest::RunTest(const FString& Parameters)
+{
+	using namespace DistanceMatchingTests;
+
+	const int32 NumQueries = 10000;
+	const int32 NumFrames = 30;
+	const float DeltaTime = 1.f / 30.f;
+
+	// A four second run cycle keyed at 30Hz, speeding up and slowing down through each stride
+	TArray<FTestKey> Keys;
+	for (int32 KeyIndex = 0; KeyIndex <= 120; ++KeyIndex)
+	{
+		const float Time = KeyIndex / 30.f;
+		Keys.Add({ Time, 100.f * Time + 10.f * FMath::Sin(Time * 2.f * PI) });
+	}
+	const TSharedRef<FDistanceMatchingTable> Table = FDistanceMatchingTable::Build(MakeCurve(Keys), 4.f);
+
+	// Every query is a character of its own, running at its own speed and keeping its own segment hint
+	FRandomStream Random(1234);
+	TArray<float> Speeds;
+	TArray<float> Distances;
+	for (int32 QueryIndex = 0; QueryIndex < NumQueries; ++QueryIndex)
+	{
+		Speeds.Add(Random.FRandRange(50.f, 600.f));
+		Distances.Add(Random.FRandRange(0.f, Table->MaxDistance));
+	}
+
+	TArray<float> ScalarTimes;
+	TArray<float> BatchedTimes;
+	TArray<int32> ScalarHints;
+	TArray<int32> BatchedHints;
+	ScalarTimes.Init(0.f, NumQueries);
+	BatchedTimes.Init(0.f, NumQueries);
+	ScalarHints.Init(INDEX_NONE, NumQueries);
+	BatchedHints.Init(INDEX_NONE, NumQueries);
+
+	double ScalarSeconds = 0.0;
+	double BatchedSeconds = 0.0;
+	for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+	{
+		for (int32 QueryIndex = 0; QueryIndex < NumQueries; ++QueryIndex)
+		{
+			Distances[QueryIndex] = FMath::Fmod(Distances[QueryIndex] + Speeds[QueryIndex] * DeltaTime, Table->MaxDistance);
+		}
+
+		double StartSeconds = FPlatformTime::Seconds();
+		for (int32 QueryIndex = 0; QueryIndex < NumQueries; ++QueryIndex)
+		{
+			Table->FindTimeForDistance(Distances[QueryIndex], ScalarTimes[QueryIndex], EDistanceMatchingPrecision::Fast, &ScalarHints[QueryIndex]);
+		}
+		ScalarSeconds += FPlatformTime::Seconds() - StartSeconds;
+
+		StartSeconds = FPlatformTime::Seconds();
+		Table->FindTimesForDistances(Distances, BatchedTimes, BatchedHints);
+		BatchedSeconds += FPlatformTime::Seconds() - StartSeconds;
+	}
+
+	for (int32 QueryIndex = 0; QueryIndex < NumQueries; ++QueryIndex)
+	{
+		if (!FMath::IsNearlyEqual(ScalarTimes[QueryIndex], BatchedTimes[QueryIndex], KINDA_SMALL_NUMBER))
+		{
+			AddError(FString::Printf(TEXT("Query %d: scalar time %f, batched time %f"), QueryIndex, ScalarTimes[QueryIndex], BatchedTimes[QueryIndex]));
+			break;
+		}
+	}
+
+	// Timings vary too much between machines to assert on, so they are reported for comparison
+	AddInfo(FString::Printf(TEXT("%d queries over %d keys, %d frames: scalar with hints %.3fms, batched %.3fms per frame"),
+		NumQueries, Table->Distances.Num(), NumFrames, ScalarSeconds * 1000.0 / NumFrames, BatchedSeconds * 1000.0 / NumFrames));
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
+//~Charlie
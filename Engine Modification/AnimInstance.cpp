@@ -254,6 +254,9 @@ void UAnimInstance::UninitializeAnimation()
 
 		MontageInstances.Empty();
 		ActiveMontagesMap.Empty();
+		//Charlie - Custom Animation Support - Instance ID lookup
+		MontageInstanceIDMap.Empty();
+		//~Charlie
 
 		OnAllMontageInstancesEnded.Broadcast();
 	}
@@ -1801,6 +1804,9 @@ float UAnimInstance::PlaySlotAnimation(UAnimSequenceBase* Asset, FName SlotNodeN
 
 	// add new section
 	NewMontage->CompositeSections.Add(NewSection);
+	//Charlie - Custom Animation Support - Section Lookup
+	NewMontage->RefreshSectionCache();
+	//~Charlie
 	NewMontage->BlendIn.SetBlendTime(BlendInTime);
 	NewMontage->BlendOut.SetBlendTime(BlendOutTime);
 
@@ -1951,6 +1957,9 @@ float UAnimInstance::Montage_Play(UAnimMontage* MontageToPlay, float InPlayRate/
 
 			MontageInstances.Add(NewInstance);
 			ActiveMontagesMap.Add(MontageToPlay, NewInstance);
+			//Charlie - Custom Animation Support - Instance ID lookup
+			MontageInstanceIDMap.Add(NewInstance->GetInstanceID(), NewInstance);
+			//~Charlie
 
 			// If we are playing root motion, set this instance as the one providing root motion.
 			if (MontageToPlay->HasRootMotion())
@@ -2143,6 +2152,63 @@ void UAnimInstance::Montage_SetNextSection(FName SectionNameToChange, FName Next
 	}
 }
 
+//Charlie - Custom Animation Support - Instance ID control
+void UAnimInstance::Montage_StopInstance(int32 MontageInstanceID, float InBlendOutTime)
+{
+	FAnimMontageInstance* MontageInstance = GetMontageInstanceForID(MontageInstanceID);
+	if (MontageInstance && MontageInstance->IsValid())
+	{
+		MontageInstance->Stop(FAlphaBlend(MontageInstance->Montage->BlendOut, InBlendOutTime));
+	}
+}
+
+void UAnimInstance::Montage_PauseInstance(int32 MontageInstanceID)
+{
+	FAnimMontageInstance* MontageInstance = GetMontageInstanceForID(MontageInstanceID);
+	if (MontageInstance)
+	{
+		MontageInstance->Pause();
+	}
+}
+
+void UAnimInstance::Montage_ResumeInstance(int32 MontageInstanceID)
+{
+	FAnimMontageInstance* MontageInstance = GetMontageInstanceForID(MontageInstanceID);
+	if (MontageInstance && !MontageInstance->IsPlaying())
+	{
+		MontageInstance->SetPlaying(true);
+	}
+}
+
+void UAnimInstance::Montage_SetPositionForInstance(int32 MontageInstanceID, float NewPosition)
+{
+	FAnimMontageInstance* MontageInstance = GetMontageInstanceForID(MontageInstanceID);
+	if (MontageInstance && MontageInstance->IsValid())
+	{
+		MontageInstance->SetPosition(NewPosition);
+	}
+}
+
+void UAnimInstance::Montage_JumpToSectionForInstance(int32 MontageInstanceID, FName SectionName)
+{
+	FAnimMontageInstance* MontageInstance = GetMontageInstanceForID(MontageInstanceID);
+	if (MontageInstance && MontageInstance->IsValid())
+	{
+		bool const bEndOfSection = (MontageInstance->GetPlayRate() < 0.f);
+		MontageInstance->JumpToSectionName(SectionName, bEndOfSection);
+	}
+}
+
+void UAnimInstance::Montage_SetNextSectionForInstance(int32 MontageInstanceID, FName SectionNameToChange, FName NextSection)
+{
+	FAnimMontageInstance* MontageInstance = GetMontageInstanceForID(MontageInstanceID);
+	if (MontageInstance && MontageInstance->IsValid())
+	{
+		MontageInstance->SetNextSectionName(SectionNameToChange, NextSection);
+	}
+}
+//~Charlie
+
 void UAnimInstance::Montage_SetPlayRate(const UAnimMontage* Montage, float NewPlayRate)
 {
 	if (Montage)
@@ -2540,6 +2606,19 @@ void UAnimInstance::ClearMontageInstanceReferences(FAnimMontageInstance& InMonta
 		}
 	}
 
+	//Charlie - Custom Animation Support - Instance ID lookup
+	// This is also called when an instance starts blending out. It should stay reachable by ID until it has terminated
+	// (the Montage is cleared, or it is about to be because the blend out has finished).
+	if (!InMontageInstance.IsValid() || (InMontageInstance.IsStopped() && InMontageInstance.GetWeight() <= 0.f))
+	{
+		FAnimMontageInstance** IDInstancePtr = MontageInstanceIDMap.Find(InMontageInstance.GetInstanceID());
+		if (IDInstancePtr && (*IDInstancePtr == &InMontageInstance))
+		{
+			MontageInstanceIDMap.Remove(InMontageInstance.GetInstanceID());
+		}
+	}
+	//~Charlie
+
 	// Clear RootMotionMontageInstance
 	if (RootMotionMontageInstance == &InMontageInstance)
 	{
@@ -2964,18 +3043,13 @@ FAnimMontageInstance* UAnimInstance::GetActiveInstanceForMontage(const UAnimMont
 	return FoundInstancePtr ? *FoundInstancePtr : nullptr;
 }
 
-FAnimMontageInstance* UAnimInstance::GetMontageInstanceForID(int32 MontageInstanceID)
+//Charlie - Custom Animation Support - Instance ID lookup
+FAnimMontageInstance* UAnimInstance::GetMontageInstanceForID(int32 MontageInstanceID) const
 {
-	for (FAnimMontageInstance* MontageInstance : MontageInstances)
-	{
-		if (MontageInstance && MontageInstance->GetInstanceID() == MontageInstanceID)
-		{
-			return MontageInstance;
-		}
-	}
-
-	return nullptr;
+	FAnimMontageInstance* const* FoundInstancePtr = MontageInstanceIDMap.Find(MontageInstanceID);
+	return FoundInstancePtr ? *FoundInstancePtr : nullptr;
 }
+//~Charlie
 
 FAnimMontageInstance* UAnimInstance::GetRootMotionMontageInstance() const
 {
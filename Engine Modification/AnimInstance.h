@@ -703,6 +703,32 @@ public:
 	UFUNCTION(BlueprintPure, Category = "Montage", meta = (NotBlueprintThreadSafe))
 	float Montage_GetPlayRate(const UAnimMontage* Montage) const;
 
+	//Charlie - Custom Animation Support - Instance ID control
+	/** Stops the montage instance with the given ID. Unlike Montage_Stop, this can reach an instance that is not the active one for its montage. */
+	UFUNCTION(BlueprintCallable, Category = "Montage")
+	void Montage_StopInstance(int32 MontageInstanceID, float InBlendOutTime);
+
+	/** Pauses the montage instance with the given ID. */
+	UFUNCTION(BlueprintCallable, Category = "Montage")
+	void Montage_PauseInstance(int32 MontageInstanceID);
+
+	/** Resumes the paused montage instance with the given ID. */
+	UFUNCTION(BlueprintCallable, Category = "Montage")
+	void Montage_ResumeInstance(int32 MontageInstanceID);
+
+	/** Sets the position of the montage instance with the given ID. */
+	UFUNCTION(BlueprintCallable, Category = "Montage")
+	void Montage_SetPositionForInstance(int32 MontageInstanceID, float NewPosition);
+
+	/** Makes the montage instance with the given ID jump to a named section. */
+	UFUNCTION(BlueprintCallable, Category = "Montage")
+	void Montage_JumpToSectionForInstance(int32 MontageInstanceID, FName SectionName);
+
+	/** Relinks the section after SectionNameToChange for the montage instance with the given ID. See Montage_SetNextSection. */
+	UFUNCTION(BlueprintCallable, Category = "Montage")
+	void Montage_SetNextSectionForInstance(int32 MontageInstanceID, FName SectionNameToChange, FName NextSection);
+	//~Charlie
+
 	/** Returns true if any montage is playing currently. Doesn't mean it's active though, it could be blending out. */
 	UFUNCTION(BlueprintPure, Category = "Montage", meta = (NotBlueprintThreadSafe))
 	bool IsAnyMontagePlaying() const;
@@ -761,7 +787,9 @@ public:
 	FAnimMontageInstance* GetActiveInstanceForMontage(const UAnimMontage* Montage) const;
 
 	/** Get the FAnimMontageInstance currently running that matches this ID.  Will return NULL if no instance is found. */
-	FAnimMontageInstance* GetMontageInstanceForID(int32 MontageInstanceID);
+	//Charlie - Custom Animation Support - Instance ID lookup
+	FAnimMontageInstance* GetMontageInstanceForID(int32 MontageInstanceID) const;
+	//~Charlie
 
 	/** Stop all montages that are active **/
 	void StopAllMontages(float BlendOut);
@@ -853,6 +881,11 @@ protected:
 	/** Map between Active Montages and their FAnimMontageInstance */
 	TMap<class UAnimMontage*, struct FAnimMontageInstance*> ActiveMontagesMap;
 
+	//Charlie - Custom Animation Support - Instance ID lookup
+	/** Montage instances keyed by instance ID. Includes instances that are blending out, until they terminate */
+	TMap<int32, struct FAnimMontageInstance*> MontageInstanceIDMap;
+	//~Charlie
+
 	/** Stop all active montages belonging to 'InGroupName' */
 	void StopAllMontagesByGroupName(FName InGroupName, const FAlphaBlend& BlendOut);
 
@@ -18,6 +18,9 @@
 #include "Animation/AnimSingleNodeInstance.h"
 #include "Engine/Engine.h"
 #include "Animation/AnimTrace.h"
+//Charlie - Custom Animation Support - Section Lookup
+#include "Algo/BinarySearch.h"
+//~Charlie
 
 DEFINE_LOG_CATEGORY(LogAnimMontage);
 
@@ -31,6 +34,10 @@ DECLARE_CYCLE_STAT(TEXT("AnimMontageInstance_HandleEvents"), STAT_AnimMontageIns
 namespace MontageFNames
 {
 	static FName TimeStretchCurveName(TEXT("MontageTimeStretchCurve"));
+	//Charlie - Custom Animation Support - Section Lookup
+	static FName LoopSectionName(TEXT("Loop"));
+	static FName OutSectionName(TEXT("Out"));
+	//~Charlie
 }
 
 ///////////////////////////////////////////////////////////////////////////
@@ -133,34 +140,78 @@ float UAnimMontage::CalculatePos(FCompositeSection &Section, float PosWithinComp
 
 int32 UAnimMontage::GetSectionIndexFromPosition(float Position) const
 {
-	for (int32 I=0; I<CompositeSections.Num(); ++I)
+	//Charlie - Custom Animation Support - Section Lookup
+	return FindSectionIndexFromPos(Position, INDEX_NONE);
+	//~Charlie
+}
+
+int32 UAnimMontage::GetAnimCompositeSectionIndexFromPos(float CurrentTime, float& PosWithinCompositeSection) const
+{
+	//Charlie - Custom Animation Support - Section Lookup
+	return GetAnimCompositeSectionIndexFromPos(CurrentTime, PosWithinCompositeSection, INDEX_NONE);
+	//~Charlie
+}
+
+//Charlie - Custom Animation Support - Section Lookup
+int32 UAnimMontage::GetAnimCompositeSectionIndexFromPos(float CurrentTime, float& PosWithinCompositeSection, int32 HintSectionIndex) const
+{
+	PosWithinCompositeSection = 0.f;
+
+	const int32 SectionIndex = FindSectionIndexFromPos(CurrentTime, HintSectionIndex);
+	if (SectionIndex != INDEX_NONE)
 	{
-		// if within
-		if( IsWithinPos(I, I+1, Position) )
-		{
-			return I;
-		}
+		PosWithinCompositeSection = CurrentTime - CompositeSections[SectionIndex].GetTime();
 	}
 
-	return INDEX_NONE;
+	return SectionIndex;
 }
 
-int32 UAnimMontage::GetAnimCompositeSectionIndexFromPos(float CurrentTime, float& PosWithinCompositeSection) const
+int32 UAnimMontage::FindSectionIndexFromPos(float CurrentTime, int32 HintSectionIndex) const
 {
-	PosWithinCompositeSection = 0.f;
+	// The end of the montage is inclusive (see IsWithinPos), which the search below does not handle, so leave it to the linear search.
+	// Each result is checked against the live section times, as they can be moved in the editor without going through RefreshSectionCache
+	if (SectionCacheNum == CompositeSections.Num() && bSectionStartTimesSorted && CurrentTime < SequenceLength)
+	{
+		// Most calls come from a montage that is still in the same section, or has just moved on to the next one
+		if (CompositeSections.IsValidIndex(HintSectionIndex))
+		{
+			if (IsWithinPos(HintSectionIndex, HintSectionIndex + 1, CurrentTime))
+			{
+				return HintSectionIndex;
+			}
+			if (CompositeSections.IsValidIndex(HintSectionIndex + 1) && IsWithinPos(HintSectionIndex + 1, HintSectionIndex + 2, CurrentTime))
+			{
+				return HintSectionIndex + 1;
+			}
+		}
+
+		// Last section starting at or before CurrentTime. If several start at the same time, only the last of them is non-empty
+		const int32 SectionIndex = Algo::UpperBound(SectionStartTimes, CurrentTime) - 1;
+		if (SectionIndex == INDEX_NONE)
+		{
+			if (CompositeSections.Num() == 0 || CompositeSections[0].GetTime() > CurrentTime)
+			{
+				return INDEX_NONE;
+			}
+		}
+		else if (IsWithinPos(SectionIndex, SectionIndex + 1, CurrentTime))
+		{
+			return SectionIndex;
+		}
+	}
 
 	for (int32 I=0; I<CompositeSections.Num(); ++I)
 	{
 		// if within
 		if (IsWithinPos(I, I+1, CurrentTime))
 		{
-			PosWithinCompositeSection = CurrentTime - CompositeSections[I].GetTime();
 			return I;
 		}
 	}
 
 	return INDEX_NONE;
 }
+//~Charlie
 
 float UAnimMontage::GetSectionTimeLeftFromPos(float Position)
 {
@@ -194,6 +245,25 @@ FCompositeSection& UAnimMontage::GetAnimCompositeSection(int32 SectionIndex)
 
 int32 UAnimMontage::GetSectionIndex(FName InSectionName) const
 {
+	//Charlie - Custom Animation Support - Section Lookup
+	// CompositeSections is public and can be edited directly, so a hit is checked against the section it points at
+	if (SectionCacheNum == CompositeSections.Num())
+	{
+		const int32* CachedSectionIndex = SectionIndexMap.Find(InSectionName);
+		if (CachedSectionIndex && CompositeSections[*CachedSectionIndex].SectionName == InSectionName)
+		{
+			return *CachedSectionIndex;
+		}
+#if !WITH_EDITOR
+		// Sections cannot be renamed outside of the editor, so a miss is a miss
+		if (!CachedSectionIndex)
+		{
+			return INDEX_NONE;
+		}
+#endif // !WITH_EDITOR
+	}
+	//~Charlie
+
 	// I can have operator== to check SectionName, but then I have to construct
 	// empty FCompositeSection all the time whenever I search :(
 	for (int32 I=0; I<CompositeSections.Num(); ++I)
@@ -207,6 +277,69 @@ int32 UAnimMontage::GetSectionIndex(FName InSectionName) const
 	return INDEX_NONE;
 }
 
+//Charlie - Custom Animation Support - Section Lookup
+int32 UAnimMontage::GetLoopSectionIndex() const
+{
+	return GetCachedSectionIndex(LoopSectionIndex, MontageFNames::LoopSectionName);
+}
+
+int32 UAnimMontage::GetOutSectionIndex() const
+{
+	return GetCachedSectionIndex(OutSectionIndex, MontageFNames::OutSectionName);
+}
+
+int32 UAnimMontage::GetCachedSectionIndex(int32 CachedSectionIndex, FName InSectionName) const
+{
+	if (SectionCacheNum == CompositeSections.Num())
+	{
+		if (CachedSectionIndex != INDEX_NONE)
+		{
+			if (CompositeSections[CachedSectionIndex].SectionName == InSectionName)
+			{
+				return CachedSectionIndex;
+			}
+		}
+#if !WITH_EDITOR
+		else
+		{
+			return INDEX_NONE;
+		}
+#endif // !WITH_EDITOR
+	}
+
+	return GetSectionIndex(InSectionName);
+}
+
+void UAnimMontage::RefreshSectionCache()
+{
+	SectionIndexMap.Reset();
+	SectionIndexMap.Reserve(CompositeSections.Num());
+	for (int32 SectionIndex = 0; SectionIndex < CompositeSections.Num(); ++SectionIndex)
+	{
+		// Keep the first section of a name, to match the linear search
+		if (!SectionIndexMap.Contains(CompositeSections[SectionIndex].SectionName))
+		{
+			SectionIndexMap.Add(CompositeSections[SectionIndex].SectionName, SectionIndex);
+		}
+	}
+	SectionCacheNum = CompositeSections.Num();
+
+	SectionStartTimes.Reset(CompositeSections.Num());
+	bSectionStartTimesSorted = true;
+	for (const FCompositeSection& Section : CompositeSections)
+	{
+		const float StartTime = Section.GetTime();
+		bSectionStartTimesSorted &= (SectionStartTimes.Num() == 0 || SectionStartTimes.Last() <= StartTime);
+		SectionStartTimes.Add(StartTime);
+	}
+
+	const int32* FoundLoopSectionIndex = SectionIndexMap.Find(MontageFNames::LoopSectionName);
+	LoopSectionIndex = FoundLoopSectionIndex ? *FoundLoopSectionIndex : INDEX_NONE;
+	const int32* FoundOutSectionIndex = SectionIndexMap.Find(MontageFNames::OutSectionName);
+	OutSectionIndex = FoundOutSectionIndex ? *FoundOutSectionIndex : INDEX_NONE;
+}
+//~Charlie
+
 FName UAnimMontage::GetSectionName(int32 SectionIndex) const
 {
 	if ( CompositeSections.IsValidIndex(SectionIndex) )
@@ -299,6 +432,10 @@ int32 UAnimMontage::AddAnimCompositeSection(FName InSectionName, float StartTime
 		}
 	}
 
+	//Charlie - Custom Animation Support - Section Lookup
+	RefreshSectionCache();
+	//~Charlie
+
 	return NewSectionIndex;
 }
 
@@ -307,6 +444,9 @@ bool UAnimMontage::DeleteAnimCompositeSection(int32 SectionIndex)
 	if ( CompositeSections.IsValidIndex(SectionIndex) )
 	{
 		CompositeSections.RemoveAt(SectionIndex);
+		//Charlie - Custom Animation Support - Section Lookup
+		RefreshSectionCache();
+		//~Charlie
 		return true;
 	}
 
@@ -323,6 +463,9 @@ void UAnimMontage::SortAnimCompositeSectionByPos()
 		}
 	};
 	CompositeSections.Sort( FCompareFCompositeSection() );
+	//Charlie - Custom Animation Support - Section Lookup
+	RefreshSectionCache();
+	//~Charlie
 }
 
 void UAnimMontage::RegisterOnMontageChanged(const FOnMontageChanged& Delegate)
@@ -597,6 +740,9 @@ void UAnimMontage::RefreshCacheData()
 
 	// This gets called whenever notifies are modified in the editor, so refresh our branch list
 	RefreshBranchingPointMarkers();
+	//Charlie - Custom Animation Support - Section Lookup
+	RefreshSectionCache();
+	//~Charlie
 #if WITH_EDITOR
 	if (!FUObjectThreadContext::Get().IsRoutingPostLoad)
 	{
@@ -700,6 +846,11 @@ void UAnimMontage::PostEditChangeProperty(FPropertyChangedEvent& PropertyChanged
 		CollectMarkers();
 	}
 
+	//Charlie - Custom Animation Support - Section Lookup
+	// Sections can be renamed from the details panel
+	RefreshSectionCache();
+	//~Charlie
+
 	PropagateChanges();
 }
 
@@ -1078,6 +1229,9 @@ void UAnimMontage::RefreshParentAssetData()
 	MarkerData = ParentMontage->MarkerData;
 	CompositeSections = ParentMontage->CompositeSections;
 	SlotAnimTracks = ParentMontage->SlotAnimTracks;
+	//Charlie - Custom Animation Support - Section Lookup
+	RefreshSectionCache();
+	//~Charlie
 
 	PreviewBasePose = ParentMontage->PreviewBasePose;
 	BranchingPointMarkers = ParentMontage->BranchingPointMarkers;
@@ -1817,7 +1971,9 @@ EMontageSubStepResult FMontageSubStepper::Advance(float& InOut_P_Original, const
 	// We need to do this even if we're not going to move this frame.
 	// We could have been moved externally via a SetPosition() call.
 	float PositionInSection;
-	CurrentSectionIndex = Montage->GetAnimCompositeSectionIndexFromPos(InOut_P_Original, PositionInSection);
+	//Charlie - Custom Animation Support - Section Lookup
+	CurrentSectionIndex = Montage->GetAnimCompositeSectionIndexFromPos(InOut_P_Original, PositionInSection, CurrentSectionIndex);
+	//~Charlie
 	if (!Montage->IsValidSectionIndex(CurrentSectionIndex))
 	{
 		return EMontageSubStepResult::InvalidSection;
@@ -2231,7 +2387,15 @@ void FAnimMontageInstance::Advance(float DeltaTime, struct FRootMotionMovementPa
 				{
 					const int32 CurrentSectionIndex = MontageSubStepper.GetCurrentSectionIndex();
 					check(NextSections.IsValidIndex(CurrentSectionIndex));
-					const int32 NextSectionIndex = bPlayingForward ? NextSections[CurrentSectionIndex] : PrevSections[CurrentSectionIndex];
+					//Charlie - Custom Animation Support - Custom Loops
+					int32 NextSectionIndex = bPlayingForward ? NextSections[CurrentSectionIndex] : PrevSections[CurrentSectionIndex];
+					//A section with custom loops remaining will jump back to itself, so it is not the end of the montage yet
+					if (NextSectionIndex == INDEX_NONE && CustomAnimationLoopingSectionOverride == CurrentSectionIndex
+						&& (CustomAnimationLoopingSectionLoops == -1 || CustomAnimationLoopingSectionLoops > 1))
+					{
+						NextSectionIndex = CurrentSectionIndex;
+					}
+					//~Charlie
 					if (NextSectionIndex == INDEX_NONE)
 					{
 						const float PlayTimeToEnd = MontageSubStepper.GetRemainingPlayTimeToSectionEnd(Position);
@@ -2316,7 +2480,7 @@ void FAnimMontageInstance::Advance(float DeltaTime, struct FRootMotionMovementPa
 						const int32 CurrentSectionIndex = MontageSubStepper.GetCurrentSectionIndex();
 						//Charlie - Custom Animation Support - Custom Loops
 						int32 RecentNextSectionIndex = bPlayingForward ? NextSections[CurrentSectionIndex] : PrevSections[CurrentSectionIndex];
-						const int32 LoopingSectionIndex = Montage->GetSectionIndex(FName(TEXT("Loop")));
+						const int32 LoopingSectionIndex = CustomAnimationLoopingSectionOverride != INDEX_NONE ? CustomAnimationLoopingSectionOverride : Montage->GetLoopSectionIndex();
 						if (CurrentSectionIndex == LoopingSectionIndex)
 						{
 							//Note: We check >1 here, as to avoid confusing an input of "1 loop" should result int he animation playing from start to end a single time.
@@ -2897,6 +3061,9 @@ UAnimMontage* UAnimMontage::CreateSlotAnimationAsDynamicMontage(UAnimSequenceBas
 
 	// add new section
 	NewMontage->CompositeSections.Add(NewSection);
+	//Charlie - Custom Animation Support - Section Lookup
+	NewMontage->RefreshSectionCache();
+	//~Charlie
 	NewMontage->BlendIn.SetBlendTime(BlendInTime);
 	NewMontage->BlendOut.SetBlendTime(BlendOutTime);
 	NewMontage->BlendOutTriggerTime = BlendOutTriggerTime;
@@ -329,6 +329,9 @@ struct ENGINE_API FAnimMontageInstance
 	//Charlie - Custom Animation Support
 	mutable float CustomAnimationLoopingSectionLoops = 0;
 	mutable bool bCustomAnimationBlendOut = true;
+	//Section that CustomAnimationLoopingSectionLoops applies to. INDEX_NONE uses the montage's "Loop" section.
+	//Dynamic montages are shared by every instance playing the same sequence, so their loop count lives here rather than in the montage's segment
+	int32 CustomAnimationLoopingSectionOverride = INDEX_NONE;
 	//~Charlie
 
 private:
@@ -706,6 +709,17 @@ public:
 	
 	/** Get SectionIndex from SectionName */
 	ENGINE_API int32 GetSectionIndex(FName InSectionName) const;
+
+	//Charlie - Custom Animation Support - Section Lookup
+	/** Get the index of the "Loop" section used by custom animation loops, or INDEX_NONE if there is none */
+	ENGINE_API int32 GetLoopSectionIndex() const;
+
+	/** Get the index of the "Out" section used to stop custom animations, or INDEX_NONE if there is none */
+	ENGINE_API int32 GetOutSectionIndex() const;
+
+	/** Rebuild the cached section lookups. Needs calling after CompositeSections is modified outside of the functions in this class */
+	ENGINE_API void RefreshSectionCache();
+	//~Charlie
 	
 	/** Get SectionName from SectionIndex in TArray */
 	ENGINE_API FName GetSectionName(int32 SectionIndex) const;
@@ -737,6 +751,11 @@ public:
 	/** Get Section Index from CurrentTime with PosWithinCompositeSection */
 	int32 GetAnimCompositeSectionIndexFromPos(float CurrentTime, float& PosWithinCompositeSection) const;
 
+	//Charlie - Custom Animation Support - Section Lookup
+	/** As above, but checks HintSectionIndex and the section after it first. Pass the section that CurrentTime was last in */
+	int32 GetAnimCompositeSectionIndexFromPos(float CurrentTime, float& PosWithinCompositeSection, int32 HintSectionIndex) const;
+	//~Charlie
+
 	/** Return time left to end of section from given position. -1.f if not a valid position */
 	ENGINE_API float GetSectionTimeLeftFromPos(float Position);
 
@@ -869,4 +888,24 @@ private:
 	void BakeTimeStretchCurve();
 	//~End Time Stretch Curve
 
+	//Charlie - Custom Animation Support - Section Lookup
+	/** Returns CachedSectionIndex if the cache is still valid for InSectionName, otherwise falls back to GetSectionIndex */
+	int32 GetCachedSectionIndex(int32 CachedSectionIndex, FName InSectionName) const;
+
+	/** Find the section containing CurrentTime, using the cached start times where possible */
+	int32 FindSectionIndexFromPos(float CurrentTime, int32 HintSectionIndex) const;
+
+	/** Section indices by name, built by RefreshSectionCache */
+	TMap<FName, int32> SectionIndexMap;
+
+	/** Number of sections when the cache was built. The cache is ignored if this no longer matches CompositeSections */
+	int32 SectionCacheNum = INDEX_NONE;
+
+	int32 LoopSectionIndex = INDEX_NONE;
+	int32 OutSectionIndex = INDEX_NONE;
+
+	/** Start time of each section, built by RefreshSectionCache. Only searched if bSectionStartTimesSorted */
+	TArray<float> SectionStartTimes;
+	bool bSectionStartTimesSorted = false;
+	//~Charlie
 };
@@ -0,0 +1,130 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+//Charlie - Custom Animation Support - Section Lookup
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "HAL/PlatformTime.h"
+#include "UObject/Package.h"
+#include "Animation/AnimMontage.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace AnimMontageTests
+{
+	static const float SectionLength = 0.5f;
+
+	/** Transient montage with NumSections evenly spaced sections */
+	static UAnimMontage* CreateMontage(int32 NumSections)
+	{
+		UAnimMontage* Montage = NewObject<UAnimMontage>(GetTransientPackage());
+		Montage->SequenceLength = NumSections * SectionLength;
+		for (int32 SectionIndex = 0; SectionIndex < NumSections; ++SectionIndex)
+		{
+			FCompositeSection Section;
+			Section.SectionName = FName(TEXT("Section"), SectionIndex + 1);
+			Section.SetTime(SectionIndex * SectionLength);
+			Montage->CompositeSections.Add(Section);
+		}
+		Montage->RefreshSectionCache();
+		return Montage;
+	}
+
+	/** The linear search that section lookup used before it was cached, including the inclusive end of the last section */
+	static int32 FindSectionLinear(const UAnimMontage& Montage, float Time)
+	{
+		const TArray<FCompositeSection>& Sections = Montage.CompositeSections;
+		for (int32 SectionIndex = 0; SectionIndex < Sections.Num(); ++SectionIndex)
+		{
+			const float StartTime = Sections[SectionIndex].GetTime();
+			const float EndTime = Sections.IsValidIndex(SectionIndex + 1) ? Sections[SectionIndex + 1].GetTime() : Montage.SequenceLength;
+			const bool bWithin = Time >= Montage.SequenceLength ? (StartTime <= Time && EndTime >= Time) : (StartTime <= Time && EndTime > Time);
+			if (bWithin)
+			{
+				return SectionIndex;
+			}
+		}
+		return INDEX_NONE;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnimMontageSectionLookupTest, "System.Engine.Animation.Montage.SectionLookup", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FAnimMontageSectionLookupTest::RunTest(const FString& Parameters)
+{
+	UAnimMontage* Montage = AnimMontageTests::CreateMontage(16);
+
+	// Every hint, including none and out of range ones, has to give the same answer as the linear search
+	const TArray<float> Times = { -0.1f, 0.f, 0.25f, 0.5f, 3.99f, 4.f, 7.75f, Montage->SequenceLength, Montage->SequenceLength + 0.1f };
+	const TArray<int32> Hints = { INDEX_NONE, 0, 7, 8, 15, 16 };
+	for (float Time : Times)
+	{
+		const int32 Expected = AnimMontageTests::FindSectionLinear(*Montage, Time);
+		for (int32 Hint : Hints)
+		{
+			float PosWithinSection = 0.f;
+			const int32 SectionIndex = Montage->GetAnimCompositeSectionIndexFromPos(Time, PosWithinSection, Hint);
+			TestEqual(FString::Printf(TEXT("Section at %.3f with hint %d"), Time, Hint), SectionIndex, Expected);
+		}
+	}
+
+	TestEqual(TEXT("Section by name"), Montage->GetSectionIndex(FName(TEXT("Section"), 10)), 9);
+	TestEqual(TEXT("Missing section by name"), Montage->GetSectionIndex(FName(TEXT("Missing"))), (int32)INDEX_NONE);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnimMontageSectionLookupPerfTest, "System.Engine.Animation.Montage.SectionLookupPerf", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FAnimMontageSectionLookupPerfTest::RunTest(const FString& Parameters)
+{
+	// Play through montages in small steps, as the montage instance does, looking the section up at each step.
+	// Few sections is the common case, and the one where the cached lookup has to keep up with the linear search
+	const int32 NumSteps = 200000;
+	const int32 SectionCounts[] = { 1, 8, 64, 256 };
+
+	for (const int32 NumSections : SectionCounts)
+	{
+		UAnimMontage* Montage = AnimMontageTests::CreateMontage(NumSections);
+		const float StepTime = Montage->SequenceLength / NumSteps;
+
+		float PosWithinSection = 0.f;
+
+		double StartSeconds = FPlatformTime::Seconds();
+		int32 Checksum = 0;
+		for (int32 Step = 0; Step < NumSteps; ++Step)
+		{
+			Checksum += AnimMontageTests::FindSectionLinear(*Montage, Step * StepTime);
+		}
+		const double LinearSeconds = FPlatformTime::Seconds() - StartSeconds;
+
+		StartSeconds = FPlatformTime::Seconds();
+		int32 BinaryChecksum = 0;
+		for (int32 Step = 0; Step < NumSteps; ++Step)
+		{
+			BinaryChecksum += Montage->GetAnimCompositeSectionIndexFromPos(Step * StepTime, PosWithinSection, INDEX_NONE);
+		}
+		const double BinarySeconds = FPlatformTime::Seconds() - StartSeconds;
+
+		StartSeconds = FPlatformTime::Seconds();
+		int32 HintedChecksum = 0;
+		int32 Hint = INDEX_NONE;
+		for (int32 Step = 0; Step < NumSteps; ++Step)
+		{
+			Hint = Montage->GetAnimCompositeSectionIndexFromPos(Step * StepTime, PosWithinSection, Hint);
+			HintedChecksum += Hint;
+		}
+		const double HintedSeconds = FPlatformTime::Seconds() - StartSeconds;
+
+		TestEqual(FString::Printf(TEXT("Binary search matches the linear search over %d sections"), NumSections), BinaryChecksum, Checksum);
+		TestEqual(FString::Printf(TEXT("Hinted search matches the linear search over %d sections"), NumSections), HintedChecksum, Checksum);
+
+		// Timings are reported rather than tested, as they depend on the machine running the test
+		AddInfo(FString::Printf(TEXT("%d lookups over %d sections: linear %.2fms, binary %.2fms, hinted %.2fms"),
+			NumSteps, NumSections, LinearSeconds * 1000.0, BinarySeconds * 1000.0, HintedSeconds * 1000.0));
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
+//~Charlie
@@ -5,126 +5,348 @@
 #include "Animation/AnimTrace.h"
 //Charlie - Distance matching implementation
 #include "Animation/AnimSequence.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "AnimNodes/AnimDistanceMatching.h"
+#include "Algo/BinarySearch.h"
 //~Charlie
 
 /////////////////////////////////////////////////////
 // FAnimNode_BlendSpaceEvaluator
 
+//Charlie - Distance Matching implementation
+const float FAnimNode_BlendSpaceEvaluator::BlendedDistanceWeightTolerance = 1.e-3f;
+//~Charlie
+
 FAnimNode_BlendSpaceEvaluator::FAnimNode_BlendSpaceEvaluator()
 	: FAnimNode_BlendSpacePlayer()
 	, NormalizedTime(0.f)
 {
 }
 
-void FAnimNode_BlendSpaceEvaluator::UpdateAssetPlayer(const FAnimationUpdateContext& Context)
+//Charlie - Distance Matching implementation
+void FAnimNode_BlendSpaceEvaluator::Initialize_AnyThread(const FAnimationInitializeContext& Context)
 {
-	GetEvaluateGraphExposedInputs().Execute(Context);
-	//Charlie - Distance Matching implementation
-	if (bUseDistanceMatching && BlendSpace && BlendSpace->GetSkeleton())
+	FAnimNode_BlendSpacePlayer::Initialize_AnyThread(Context);
+	bDistanceCurveDirty = true;
+	bLastMatchedDistanceValid = false;
+}
+
+void FAnimNode_BlendSpaceEvaluator::CacheBones_AnyThread(const FAnimationCacheBonesContext& Context)
+{
+	FAnimNode_BlendSpacePlayer::CacheBones_AnyThread(Context);
+	if (bUseDistanceMatching)
 	{
-		const float inputDistance = NormalizedTime;
-		const float prevTime = InternalTimeAccumulator;
+		ResolveDistanceCurve();
+	}
+}
 
-		FSmartName CurveName;
-		BlendSpace->GetSkeleton()->GetSmartNameByName(USkeleton::AnimCurveMappingName, DistanceCurve, CurveName);
+void FAnimNode_BlendSpaceEvaluator::OverrideAsset(UAnimationAsset* NewAsset)
+{
+	FAnimNode_BlendSpacePlayer::OverrideAsset(NewAsset);
+	bDistanceCurveDirty = true;
+}
 
-		const FVector BlendInput(X, Y, Z);
-		TArray<FBlendSampleData> BlendSamples;
-		BlendSpace->GetSamplesFromBlendInput(BlendInput, BlendSamples);
+void FAnimNode_BlendSpaceEvaluator::ResolveDistanceCurve()
+{
+	DistanceCurveBlendSpace = BlendSpace;
+	DistanceCurveName = DistanceCurve;
+	DistanceCurveUID = DistanceMatching::ResolveCurveUID(BlendSpace ? BlendSpace->GetSkeleton() : nullptr, DistanceCurve);
+	bDistanceCurveDirty = false;
+
+	//The blended curve was built from the old curve
+	BlendedDistanceBlendSpace = nullptr;
+	BlendedDistanceSamples.Reset();
+	BlendedDistanceSource.Reset();
+}
+
+bool FAnimNode_BlendSpaceEvaluator::IsBlendedDistanceCurveValid()
+{
+	if (BlendSpace != BlendedDistanceBlendSpace || DistanceMatchingSamples.Num() != BlendedDistanceSamples.Num())
+	{
+		return false;
+	}
+
+	for (int32 SampleIndex = 0; SampleIndex < DistanceMatchingSamples.Num(); ++SampleIndex)
+	{
+		const FBlendSampleData& Sample = DistanceMatchingSamples[SampleIndex];
+		const FBlendedDistanceSample& BlendedSample = BlendedDistanceSamples[SampleIndex];
+		if (Sample.SampleDataIndex != BlendedSample.SampleDataIndex || !FMath::IsNearlyEqual(Sample.GetWeight(), BlendedSample.Weight, BlendedDistanceWeightTolerance))
+		{
+			return false;
+		}
+	}
+
+#if WITH_EDITOR
+	//Pick up any edits made to the samples or their curves. Nothing needs checking until an asset has been edited
+	if (BlendedDistanceEditCount != FDistanceMatchingTableCache::GetEditCount())
+	{
+		BlendedDistanceEditCount = FDistanceMatchingTableCache::GetEditCount();
+		if (FDistanceMatchingTableCache::FindOrBuildBlendSpace(BlendSpace, DistanceCurve, DistanceCurveUID) != BlendedDistanceSource)
+		{
+			return false;
+		}
+	}
+#endif
+
+	return true;
+}
+
+void FAnimNode_BlendSpaceEvaluator::BuildBlendedDistanceCurve()
+{
+	BlendedDistanceBlendSpace = BlendSpace;
+	BlendedDistanceSamples.Reset();
+
+	//Distances on the old curve do not carry over
+	bLastMatchedDistanceValid = false;
+
+	//The keys are laid out once per blend space, with just enough of them to follow every sample's curve
+#if WITH_EDITOR
+	BlendedDistanceEditCount = FDistanceMatchingTableCache::GetEditCount();
+#endif
+	BlendedDistanceSource = FDistanceMatchingTableCache::FindOrBuildBlendSpace(BlendSpace, DistanceCurve, DistanceCurveUID);
+	//Copy into the existing allocation. Assigning the array would resize it to fit the source each time
+	BlendedDistanceTimes.Reset();
+	if (BlendedDistanceSource.IsValid())
+	{
+		BlendedDistanceTimes.Append(BlendedDistanceSource->Times);
+	}
+	else
+	{
+		BlendedDistanceTimes.Add(0.f);
+		BlendedDistanceTimes.Add(1.f);
+	}
 
-		//Note: To get curve info in a release build when the animations are compressed, it might be necessary to do this:
-		// FAnimCurveBufferAcess CurveBuffer = FAnimCurveBufferAccess(BlendSamples[0].Animation, CurveName.UID);
+	//Reset the curve that will be used for blending. The keys are only allocated the first time round
+	const int32 numKeys = BlendedDistanceTimes.Num();
+	BlendedDistances.SetNumZeroed(numKeys, false);
+
+	//Iterate over all of the sample animations in the blend space
+	for (const FBlendSampleData& sample : DistanceMatchingSamples)
+	{
+		BlendedDistanceSamples.Add({ sample.SampleDataIndex, sample.GetWeight() });
+
+		//Grab the sample's distances at each key. These come from the shared distance tables, which still work when the raw curve has been stripped from a cooked build
+		//If the curve does not exist, skip
+		if (!BlendedDistanceSource.IsValid() || !BlendedDistanceSource->SampleDistances.IsValidIndex(sample.SampleDataIndex))
+			continue;
+
+		const TArray<float>& sampleDistances = BlendedDistanceSource->SampleDistances[sample.SampleDataIndex];
+		if (sampleDistances.Num() != numKeys)
+			continue;
+
+		//Multiply the sample's distances by its weight and add them to the running total for each blended key
+		DistanceMatching::AddWeighted(BlendedDistances, sampleDistances, sample.GetWeight());
+	}
+
+	BuildBlendedDistanceRuns();
+}
+
+void FAnimNode_BlendSpaceEvaluator::BuildBlendedDistanceRuns()
+{
+	BlendedDistanceRuns.Reset();
+	BlendedSearchDistances.Reset();
+
+	auto addRun = [this](int32 firstKey, int32 lastKey, bool bIncreasing)
+	{
+		FBlendedDistanceRun& run = BlendedDistanceRuns.AddDefaulted_GetRef();
+		run.FirstKey = firstKey;
+		run.LastKey = lastKey;
+		run.SearchOffset = BlendedSearchDistances.Num();
+		run.MinDistance = bIncreasing ? BlendedDistances[firstKey] : BlendedDistances[lastKey];
+		run.MaxDistance = bIncreasing ? BlendedDistances[lastKey] : BlendedDistances[firstKey];
+		run.bIncreasing = bIncreasing;
+
+		//Falling runs are searched for the negated distance
+		for (int32 keyIndex = firstKey; keyIndex <= lastKey; ++keyIndex)
+		{
+			BlendedSearchDistances.Add(bIncreasing ? BlendedDistances[keyIndex] : -BlendedDistances[keyIndex]);
+		}
+	};
 
-		//Create an empty curve that will be used for blending
-		FRichCurve BlendedDistanceCurve;
-		//Create keys (Normalized)
-		for (int i = 0; i <= 10; i++)
+	//Split the curve wherever it turns around. Flat stretches stay with the run they are in
+	BlendedMinKey = 0;
+	BlendedMaxKey = 0;
+	int32 firstKey = 0;
+	int32 direction = 0;
+	for (int32 keyIndex = 1; keyIndex < BlendedDistances.Num(); ++keyIndex)
+	{
+		const float delta = BlendedDistances[keyIndex] - BlendedDistances[keyIndex - 1];
+		const int32 keyDirection = delta > 0.0f ? 1 : (delta < 0.0f ? -1 : 0);
+		if (keyDirection != 0 && direction != 0 && keyDirection != direction)
+		{
+			addRun(firstKey, keyIndex - 1, direction > 0);
+			firstKey = keyIndex - 1;
+		}
+		if (keyDirection != 0)
 		{
-			//We add some blank keys along the cruve with a value of 0
-			BlendedDistanceCurve.Keys.Add(FRichCurveKey(0.1f * i, 0.0f));
+			direction = keyDirection;
 		}
 
-		//Iterate over all of the sample animations in the blend space
-		for (const FBlendSampleData& sample : BlendSamples)
+		//The first lowest and the last highest key, so a rising curve clamps to its start and end as it always has
+		if (BlendedDistances[keyIndex] < BlendedDistances[BlendedMinKey])
 		{
-			if (sample.Animation)
-			{
-				const float timeMultiplier = sample.Animation->GetPlayLength();
-				//Grab the curve from the sample
-				const FFloatCurve* Curve = (const FFloatCurve*)sample.Animation->GetCurveData().GetCurveData(CurveName.UID);
-				//If the curve does not exist, skip
-				if (!Curve)
-					continue;
-				//Iterate over every key in our BLENDED distance curve
-				for (FRichCurveKey& key : BlendedDistanceCurve.Keys)
-				{
-					//Either sqaush or stretch the other curve so that it fits within our blended curve
-					//This works as the keys within the blended curve were set at a normalized time (0->1)
-					const float adjustedTime = key.Time * timeMultiplier;
-
-					//Calculate the new value for our blended key by evaluating the anim curve at the 
-					//adjusted time. We then multiply this evaluated value by the weighting of the sample animation
-					//and then add it to the running total for the blended key.
-					const float value = Curve->Evaluate(adjustedTime) * sample.GetWeight() + key.Value;
-					key.Value = value;
-				}
-			}
+			BlendedMinKey = keyIndex;
 		}
+		if (BlendedDistances[keyIndex] >= BlendedDistances[BlendedMaxKey])
+		{
+			BlendedMaxKey = keyIndex;
+		}
+	}
+	addRun(firstKey, BlendedDistances.Num() - 1, direction >= 0);
+}
 
-		//Get Min, max and Delta values
-		const float maxDistance = BlendedDistanceCurve.Keys.Last().Value;
-		const float minDistance = BlendedDistanceCurve.Keys[0].Value;
-		const float deltaDistance = maxDistance - minDistance; //This can be used to determine if the curve goes positive or negative. For now, assume positive
+float FAnimNode_BlendSpaceEvaluator::FindTimeForBlendedDistance(float& InOutDistance, float PrevTime, float Direction)
+{
+	//Find the run that the previous time is in, and whether time moves forwards or backwards through the curve to follow the distance
+	const FBlendedDistanceRun* prevRun = BlendedDistanceRuns.FindByPredicate([this, PrevTime](const FBlendedDistanceRun& run)
+	{
+		return PrevTime >= BlendedDistanceTimes[run.FirstKey] && PrevTime <= BlendedDistanceTimes[run.LastKey];
+	});
+	const int32 timeDirection = (prevRun == nullptr || Direction == 0.0f) ? 0 : ((Direction > 0.0f) == prevRun->bIncreasing ? 1 : -1);
 
-		//Calculate the Distance to match
-		float distance = bUseDeltaDistance ? BlendedDistanceCurve.Eval(prevTime) + inputDistance : inputDistance;
+	//Pick the run that reaches the distance. The previous run is kept if it can be, otherwise the nearest run in the direction time is moving,
+	//and only then the nearest run the other way
+	const FBlendedDistanceRun* bestRun = nullptr;
+	float bestCost = MAX_flt;
+	for (const FBlendedDistanceRun& run : BlendedDistanceRuns)
+	{
+		if (InOutDistance < run.MinDistance || InOutDistance > run.MaxDistance)
+			continue;
 
-		if (bLoop)
+		if (&run == prevRun)
 		{
-			//Handle cases where the distance loops past the start or the end
-			if (distance > maxDistance)
-			{
-				distance = minDistance + fmod(distance, deltaDistance);
-			}
-			else if (distance < minDistance)
-			{
-				distance = maxDistance - fmod(distance, deltaDistance);
-			}
+			bestRun = &run;
+			break;
 		}
 
-		if (distance >= maxDistance)
+		const float gapAhead = BlendedDistanceTimes[run.FirstKey] - PrevTime;
+		const float gapBehind = PrevTime - BlendedDistanceTimes[run.LastKey];
+		float cost = FMath::Max(gapAhead, gapBehind);
+		if (timeDirection > 0)
+		{
+			cost = gapAhead >= 0.0f ? gapAhead : 1.0f + gapBehind;
+		}
+		else if (timeDirection < 0)
+		{
+			cost = gapBehind >= 0.0f ? gapBehind : 1.0f + gapAhead;
+		}
+
+		if (cost < bestCost)
+		{
+			bestCost = cost;
+			bestRun = &run;
+		}
+	}
+
+	//The curve never reaches the distance, so hold at the nearest end of its range
+	if (bestRun == nullptr)
+	{
+		const int32 clampKey = InOutDistance > BlendedDistances[BlendedMaxKey] ? BlendedMaxKey : BlendedMinKey;
+		InOutDistance = BlendedDistances[clampKey];
+		BlendedDistanceSegmentHint = INDEX_NONE;
+		return BlendedDistanceTimes[clampKey];
+	}
+
+	//Find the first key past our current distance travelled within the run, searching outwards from the segment found last update
+	const FBlendedDistanceRun& run = *bestRun;
+	const int32 numRunKeys = run.LastKey - run.FirstKey + 1;
+	const TArrayView<const float> searchDistances(BlendedSearchDistances.GetData() + run.SearchOffset, numRunKeys);
+	//Search distances are negated on falling runs so that every run rises, which leaves the interpolation alpha unchanged
+	const TArrayView<const float> runTimes(BlendedDistanceTimes.GetData() + run.FirstKey, numRunKeys);
+	const float searchDistance = run.bIncreasing ? InOutDistance : -InOutDistance;
+	//The distance lies within the run, so it is always found. Should rounding say otherwise, hold at the end of the run
+	float time = runTimes.Last();
+	int32 runKeyIndex = BlendedDistanceSegmentHint - run.FirstKey;
+	DistanceMatching::FindTimesForDistances(runTimes, searchDistances, MakeArrayView(&searchDistance, 1), MakeArrayView(&time, 1), MakeArrayView(&runKeyIndex, 1));
+	BlendedDistanceSegmentHint = run.FirstKey + FMath::Clamp(runKeyIndex, 1, numRunKeys - 1);
+	return time;
+}
+
+float FAnimNode_BlendSpaceEvaluator::GetBlendedDistance(float Time) const
+{
+	const int32 numKeys = BlendedDistances.Num();
+	if (numKeys < 2)
+	{
+		return numKeys == 1 ? BlendedDistances[0] : 0.f;
+	}
+
+	//The keys are not evenly spaced, so search for the segment
+	const int32 index = FMath::Clamp(Algo::UpperBound(BlendedDistanceTimes, Time), 1, numKeys - 1);
+	const float prevKeyTime = BlendedDistanceTimes[index - 1];
+	const float keyDuration = BlendedDistanceTimes[index] - prevKeyTime;
+	const float alpha = keyDuration > 0.f ? FMath::Clamp((Time - prevKeyTime) / keyDuration, 0.f, 1.f) : 0.f;
+	return FMath::Lerp(BlendedDistances[index - 1], BlendedDistances[index], alpha);
+}
+float FAnimNode_BlendSpaceEvaluator::MatchBlendedDistance(float InputDistance, float PrevTime)
+{
+	//Get the distances at either end. The curve can rise, fall, or turn around in between (e.g. stop and pivot animations)
+	const float startDistance = BlendedDistances[0];
+	const float endDistance = BlendedDistances.Last();
+
+	//Calculate the Distance to match, and which way it has moved since the last update
+	float distance = InputDistance;
+	float direction = 0.0f;
+	if (bUseDeltaDistance)
+	{
+		//Carry on from the distance matched last update, unless the curve has been rebuilt or the time has been moved since
+		const bool bUseLastMatch = bLastMatchedDistanceValid && PrevTime == LastMatchedTime;
+		distance += bUseLastMatch ? LastMatchedDistance : GetBlendedDistance(PrevTime);
+		direction = InputDistance;
+	}
+	else if (bLastMatchedDistanceValid)
+	{
+		direction = distance - LastMatchedDistance;
+	}
+
+	if (bLoop)
+	{
+		//Handle cases where the distance loops past the start or the end, in either direction
+		const float loopMinDistance = FMath::Min(startDistance, endDistance);
+		const float cycleDistance = FMath::Abs(endDistance - startDistance);
+		if (cycleDistance > 0.0f && (distance < loopMinDistance || distance > loopMinDistance + cycleDistance))
 		{
-			InternalTimeAccumulator = 1.0f;
+			distance -= FMath::FloorToFloat((distance - loopMinDistance) / cycleDistance) * cycleDistance;
 		}
-		else if (distance <= minDistance)
+	}
+
+	const float time = FindTimeForBlendedDistance(distance, PrevTime, direction);
+
+	LastMatchedTime = time;
+	LastMatchedDistance = distance;
+	bLastMatchedDistanceValid = true;
+	return time;
+}
+//~Charlie
+
+void FAnimNode_BlendSpaceEvaluator::UpdateAssetPlayer(const FAnimationUpdateContext& Context)
+{
+	GetEvaluateGraphExposedInputs().Execute(Context);
+	//Charlie - Distance Matching implementation
+	if (bUseDistanceMatching && BlendSpace && BlendSpace->GetSkeleton())
+	{
+		LLM_SCOPE(ELLMTag::Animation);
+
+		const float inputDistance = NormalizedTime;
+		const float prevTime = InternalTimeAccumulator;
+
+		//The curve UID is only looked up again if the blend space or curve name has changed (e.g. through a pin)
+		if (bDistanceCurveDirty || BlendSpace != DistanceCurveBlendSpace || DistanceCurve != DistanceCurveName)
 		{
-			InternalTimeAccumulator = 0.0f;
+			ResolveDistanceCurve();
 		}
-		else
+
+		const FVector BlendInput(X, Y, Z);
+		DistanceMatchingSamples.Reset();
+		BlendSpace->GetSamplesFromBlendInput(BlendInput, DistanceMatchingSamples);
+
+		//The blended curve only changes with the samples and their weights, so it is kept while the blend input holds steady
+		if (!IsBlendedDistanceCurveValid())
 		{
-			float time = 0.0f;
-			FRichCurveKey prevKey;
-			//Iterate over our blended curve
-			for (const FRichCurveKey& key : BlendedDistanceCurve.Keys)
-			{
-				//If the value of the key is greater than our current distance travelled
-				if (key.Value > distance)
-				{
-					//Calculate the distance delta between this key and the previous key
-					const float delta = key.Value - prevKey.Value;
-					//Calculate the alpha so that we know how "far" between the keys we were
-					const float alpha = delta != 0.0f ? (distance - prevKey.Value) / delta : 0.0f;
-					//Calculate a new time based on that alpha
-					time = prevKey.Time + alpha * (key.Time - prevKey.Time);
-					//Stop iteration
-					break;
-				}
-				prevKey = key;
-			}
-
-			//Normalize Playtime
-			InternalTimeAccumulator = time;
+			BuildBlendedDistanceCurve();
 		}
+
+		//Normalize Playtime
+		InternalTimeAccumulator = MatchBlendedDistance(inputDistance, prevTime);
 	}
 	else
 	{
@@ -5,8 +5,16 @@
 #include "CoreMinimal.h"
 #include "UObject/ObjectMacros.h"
 #include "AnimNodes/AnimNode_BlendSpacePlayer.h"
+//Charlie - Distance Matching Implementation
+#include "Animation/SmartName.h"
+#include "Templates/SharedPointer.h"
+//~Charlie
 #include "AnimNode_BlendSpaceEvaluator.generated.h"
 
+//Charlie - Distance Matching Implementation
+struct FDistanceMatchingBlendSpaceTable;
+//~Charlie
+
 // Evaluates a point in a blendspace, using a specific time input rather than advancing time internally.
 // Typically the playback position of the animation for this node will represent something other than time, like jump height.
 // This node will not trigger any notifies present in the associated sequence.
@@ -36,7 +44,106 @@ public:
 	FAnimNode_BlendSpaceEvaluator();
 
 	// FAnimNode_Base interface
+	//Charlie - Distance Matching Implementation
+	virtual void Initialize_AnyThread(const FAnimationInitializeContext& Context) override;
+	virtual void CacheBones_AnyThread(const FAnimationCacheBonesContext& Context) override;
+	virtual void OverrideAsset(UAnimationAsset* NewAsset) override;
+	//~Charlie
 	virtual void UpdateAssetPlayer(const FAnimationUpdateContext& Context) override;
 	virtual void GatherDebugData(FNodeDebugData& DebugData) override;
 	// End of FAnimNode_Base interface
+
+	//Charlie - Distance Matching Implementation
+protected:
+	/** Resolve the distance curve UID for the current BlendSpace and DistanceCurve */
+	void ResolveDistanceCurve();
+
+	/** Whether the blended distance curve was built from the blend space and samples in DistanceMatchingSamples, within BlendedDistanceWeightTolerance */
+	bool IsBlendedDistanceCurveValid();
+
+	/** Blend the distances of DistanceMatchingSamples at the blend space's key layout into BlendedDistanceTimes and BlendedDistances */
+	void BuildBlendedDistanceCurve();
+
+	/** Split the blended distance curve into runs that only rise or only fall */
+	void BuildBlendedDistanceRuns();
+
+	/** Normalized time at which the blended distance curve reaches this update's distance input, carrying on from PrevTime */
+	float MatchBlendedDistance(float InputDistance, float PrevTime);
+
+	/** Blended distance at a normalized time, interpolating linearly between keys */
+	float GetBlendedDistance(float Time) const;
+
+	/**
+	 * Normalized time at which the blended distance curve reaches InOutDistance, or the nearest end of its range if it never does (InOutDistance is clamped to match).
+	 * Where the curve reaches the distance more than once, the run that PrevTime is in is preferred, then the nearest run in the direction that Direction (the change in distance) moves time
+	 */
+	float FindTimeForBlendedDistance(float& InOutDistance, float PrevTime, float Direction);
+
+	/** Blend space and curve name that the UID was last resolved for. If either pin changes, it is resolved again */
+	UBlendSpaceBase* DistanceCurveBlendSpace = nullptr;
+	FName DistanceCurveName;
+	SmartName::UID_Type DistanceCurveUID = SmartName::MaxUID;
+
+	/** Set when the UID needs resolving again regardless, e.g. the asset has been overridden */
+	bool bDistanceCurveDirty = true;
+
+	// Scratch data for distance matching. Kept on the node and reused every update so that updating does not allocate
+	TArray<FBlendSampleData> DistanceMatchingSamples;
+
+	/** Keys of the blended distance curve: normalized times and the weighted sum of the samples' distances at each */
+	TArray<float> BlendedDistanceTimes;
+	TArray<float> BlendedDistances;
+
+	/** A sample that the blended distance curve was built from */
+	struct FBlendedDistanceSample
+	{
+		int32 SampleDataIndex;
+		float Weight;
+	};
+
+	/** Blend space and samples that the blended distance curve was built from. It is only built again once these change */
+	UBlendSpaceBase* BlendedDistanceBlendSpace = nullptr;
+	TArray<FBlendedDistanceSample> BlendedDistanceSamples;
+
+	/** Key layout and sample distances that the blended distance curve was built from */
+	TSharedPtr<const FDistanceMatchingBlendSpaceTable> BlendedDistanceSource;
+
+#if WITH_EDITOR
+	/** FDistanceMatchingTableCache::GetEditCount() when BlendedDistanceSource was last checked */
+	int32 BlendedDistanceEditCount = 0;
+#endif
+
+	/** A stretch of the blended distance curve that only rises or only falls, so it can be searched. Neighbouring runs share the key where the curve turns */
+	struct FBlendedDistanceRun
+	{
+		int32 FirstKey;
+		int32 LastKey;
+		/** Where the run's keys start in BlendedSearchDistances */
+		int32 SearchOffset;
+		float MinDistance;
+		float MaxDistance;
+		bool bIncreasing;
+	};
+
+	/** Runs of the blended distance curve, in time order. Built along with the curve */
+	TArray<FBlendedDistanceRun> BlendedDistanceRuns;
+
+	/** Each run's distances, negated for falling runs so that every run can be searched as a rising one */
+	TArray<float> BlendedSearchDistances;
+
+	/** Keys at which the blended distance curve is lowest and highest */
+	int32 BlendedMinKey = 0;
+	int32 BlendedMaxKey = 0;
+
+	/** Segment of the blended distance curve found by the last update, where the next search starts */
+	int32 BlendedDistanceSegmentHint = INDEX_NONE;
+
+	/** Time and distance matched by the last update. While the blended curve and the time are left alone, delta distances carry on from here */
+	float LastMatchedTime = 0.f;
+	float LastMatchedDistance = 0.f;
+	bool bLastMatchedDistanceValid = false;
+
+	/** How far a sample weight can move before the blended distance curve is built again */
+	static const float BlendedDistanceWeightTolerance;
+	//~Charlie
 };
@@ -3,6 +3,10 @@
 #include "AnimNodes/AnimNode_SequenceEvaluator.h"
 #include "Animation/AnimInstanceProxy.h"
 #include "Animation/AnimTrace.h"
+//Charlie - Distance Matching implementation
+#include "AnimNodes/AnimDistanceMatching.h"
+#include "HAL/LowLevelMemTracker.h"
+//~Charlie
 
 float FAnimNode_SequenceEvaluator::GetCurrentAssetTime()
 {
@@ -22,13 +26,107 @@ void FAnimNode_SequenceEvaluator::Initialize_AnyThread(const FAnimationInitializ
 	DECLARE_SCOPE_HIERARCHICAL_COUNTER_ANIMNODE(Initialize_AnyThread)
 	FAnimNode_AssetPlayerBase::Initialize_AnyThread(Context);
 	bReinitialized = true;
+	//Charlie - Distance Matching implementation
+	bDistanceCurveDirty = true;
+	//~Charlie
 }
 
 void FAnimNode_SequenceEvaluator::CacheBones_AnyThread(const FAnimationCacheBonesContext& Context)
 {
 	DECLARE_SCOPE_HIERARCHICAL_COUNTER_ANIMNODE(CacheBones_AnyThread)
+	//Charlie - Distance Matching implementation
+	if (bShouldUseExplicityTimeAsDistanceCurveLookup)
+	{
+		ResolveDistanceCurve();
+	}
+	//~Charlie
 }
 
+//Charlie - Distance Matching implementation
+void FAnimNode_SequenceEvaluator::ResolveDistanceCurve()
+{
+	//Where the node is on the curve only stops meaning anything if it is a different curve.
+	//Resolving the same one again (e.g. after a LOD change re-caches bones) carries on from there
+	if (Sequence != DistanceCurveSequence || DistanceCurve != DistanceCurveName)
+	{
+		DistanceCurveSequence = Sequence;
+		DistanceCurveName = DistanceCurve;
+		DistanceSegmentHint = INDEX_NONE;
+		DistanceLoop.Reset();
+		bDistanceLoopReset = true;
+	}
+
+	DistanceCurveUID = DistanceMatching::ResolveCurveUID(Sequence ? Sequence->GetSkeleton() : nullptr, DistanceCurve);
+#if WITH_EDITOR
+	DistanceTableEditCount = FDistanceMatchingTableCache::GetEditCount();
+#endif
+	DistanceTable = FDistanceMatchingTableCache::FindOrBuild(Sequence, DistanceCurve, DistanceCurveUID);
+	bDistanceCurveDirty = false;
+}
+
+bool FAnimNode_SequenceEvaluator::IsFollowingSyncGroup(const FAnimationUpdateContext& Context) const
+{
+	if (GroupIndex == INDEX_NONE)
+	{
+		return false;
+	}
+
+	if (GroupRole == EAnimGroupRole::AlwaysFollower)
+	{
+		return true;
+	}
+
+	//Leadership is only known once the group has ticked, so go by who led it last update
+	const TArray<FAnimGroupInstance>& SyncGroups = Context.AnimInstanceProxy->GetSyncGroupRead();
+	if (SyncGroups.IsValidIndex(GroupIndex))
+	{
+		const FAnimGroupInstance& SyncGroup = SyncGroups[GroupIndex];
+		if (SyncGroup.ActivePlayers.IsValidIndex(SyncGroup.GroupLeaderIndex))
+		{
+			return SyncGroup.ActivePlayers[SyncGroup.GroupLeaderIndex].TimeAccumulator != &InternalTimeAccumulator;
+		}
+	}
+
+	return false;
+}
+float FAnimNode_SequenceEvaluator::MatchDistance(float DeltaTime, bool bTeleportToDistance, int32& OutCyclesCrossed)
+{
+	//Get the previous position of the curve
+	const float prevDistance = DistanceTable->GetDistanceForTime(StartPosition);
+	//Get the current position of the curve (If we are using the input param (ExplicitTime) as a delta or a speed, perform a calculation)
+	const bool bInputIsDelta = bDistanceCurveInputIsDeltaDistance || bDistanceCurveInputIsSpeed;
+	const float deltaDistance = bDistanceCurveInputIsSpeed ? ExplicitTime * DeltaTime : ExplicitTime;
+	float currentDistance = bInputIsDelta ? prevDistance + deltaDistance : ExplicitTime;
+
+	const float maxTime = Sequence->GetPlayLength();
+	const float maxDistance = DistanceTable->MaxDistance;
+	float time = currentDistance < prevDistance ? 0.0f : StartPosition;
+
+	OutCyclesCrossed = 0;
+	if (bShouldLoop)
+	{
+		//Bring the distance back into a single cycle of the curve. This works in either direction, and however many cycles were crossed this frame
+		const int32 prevCycle = DistanceLoop.CycleCount;
+		currentDistance = DistanceLoop.Wrap(*DistanceTable, currentDistance, bInputIsDelta);
+		OutCyclesCrossed = bTeleportToDistance ? 0 : DistanceLoop.CycleCount - prevCycle;
+	}
+	else if (currentDistance > maxDistance)
+	{
+		time = maxTime;
+	}
+
+	//Find the time at which the curve reaches the distance travelled.
+	//If it never does (the distance is past the last key), time keeps the value set above.
+	//Each node updates on its own task, so this is a batch of one; the batched solver pays off for callers that hold many queries at once
+	if (prevDistance != currentDistance)
+	{
+		DistanceTable->FindTimesForDistances(MakeArrayView(&currentDistance, 1), MakeArrayView(&time, 1), MakeArrayView(&DistanceSegmentHint, 1), DistanceMatchingPrecision);
+	}
+	StartPosition = time;
+	return time;
+}
+//~Charlie
+
 void FAnimNode_SequenceEvaluator::UpdateAssetPlayer(const FAnimationUpdateContext& Context)
 {
 	GetEvaluateGraphExposedInputs().Execute(Context);
@@ -38,62 +136,60 @@ void FAnimNode_SequenceEvaluator::UpdateAssetPlayer(const FAnimationUpdateContex
 		//Charlie - Distance Matching Implementation
 		if (bShouldUseExplicityTimeAsDistanceCurveLookup && Sequence->GetSkeleton())
 		{
-			FSmartName CurveName;
-			Sequence->GetSkeleton()->GetSmartNameByName(USkeleton::AnimCurveMappingName, DistanceCurve, CurveName);
-			const FFloatCurve* Curve = (const FFloatCurve*)Sequence->GetCurveData().GetCurveData(CurveName.UID);
-			if (Curve)
-			{
-				//Get the previous position of the curve
-				const float prevDistance = Curve->Evaluate(StartPosition);
-				//Get the current position of the curve (If we are using the input param (ExplicitTime) as a delta representation, perform a calculation)
-				float currentDistance = bDistanceCurveInputIsDeltaDistance ? prevDistance + ExplicitTime : ExplicitTime;
+			LLM_SCOPE(ELLMTag::Animation);
 
-				const float maxTime = Sequence->GetPlayLength();
-				const float maxDistance = Curve->Evaluate(maxTime);
-				float distance = 0.0f;
-				float time = currentDistance < prevDistance ? 0.0f : StartPosition;
+			//The curve is only looked up again if the sequence or curve name has changed (e.g. through a pin)
+			if (bDistanceCurveDirty || Sequence != DistanceCurveSequence || DistanceCurve != DistanceCurveName)
+			{
+				ResolveDistanceCurve();
+			}
+#if WITH_EDITOR
+			else if (DistanceTableEditCount != FDistanceMatchingTableCache::GetEditCount())
+			{
+				//Pick up any edits made to the curve. Nothing needs checking until an asset has been edited
+				DistanceTableEditCount = FDistanceMatchingTableCache::GetEditCount();
+				DistanceTable = FDistanceMatchingTableCache::FindOrBuild(Sequence, DistanceCurve, DistanceCurveUID);
+			}
+#endif
 
-				if (currentDistance > maxDistance)
+			//A follower's time is set by the group leader, so there is no distance to solve for.
+			//Keep track of where the group put it, so matching carries on from there if this node takes the lead
+			if (IsFollowingSyncGroup(Context))
+			{
+				StartPosition = InternalTimeAccumulator;
+				if (Context.AnimInstanceProxy->IsSkeletonCompatible(Sequence->GetSkeleton()))
 				{
-					if (!bShouldLoop)
-					{
-						time = maxTime;
-						//Skip the loop
-						distance = currentDistance;
-					}
-					else
-					{
-						//If we are in a loop, do fmod for the distance
-						time = 0.0f;
-						currentDistance = fmod(currentDistance, maxDistance);
-					}
+					CreateTickRecordForNode(Context, Sequence, bShouldLoop, DistancePlayRate);
 				}
+			}
+			//The inverse of the curve is baked once per sequence and shared by every node matching against it
+			else if (DistanceTable.IsValid())
+			{
+				//After a reset there is nothing to advance from. An absolute distance would otherwise count every cycle up to it as crossed this frame
+				const bool bTeleportToDistance = bReinitialized || bDistanceLoopReset;
+				bDistanceLoopReset = false;
+
+				int32 cyclesCrossed = 0;
+				const float time = MatchDistance(Context.GetDeltaTime(), bTeleportToDistance, cyclesCrossed);
+				const float maxTime = Sequence->GetPlayLength();
 
-				//Progress time and look at the distance traveled
-				//When distance is bigger, break out of loop
-				if (prevDistance != currentDistance)
+				//As with ExplicitTime, advance to the matched time through a tick record unless teleporting, so notifies and root motion come from the sequence
+				if ((!bTeleportToExplicitTime || (GroupIndex != INDEX_NONE)) && (Context.AnimInstanceProxy->IsSkeletonCompatible(Sequence->GetSkeleton())))
 				{
-					FRichCurveKey prevKey;
-					const TArray<FRichCurveKey>& floatCurve = Curve->FloatCurve.GetCopyOfKeys();
-					//Iterate over keys in curve
-					for (const FRichCurveKey& key : floatCurve)
+					if (bTeleportToDistance)
 					{
-						//If the value of the key is greater than our current distance travelled
-						if (key.Value >= currentDistance)
-						{
-							//Calculate the distance delta between this key and the previous key
-							const float delta = key.Value - prevKey.Value;
-							//Calculate the alpha so that we know how "far" between the keys we were
-							const float alpha = delta != 0.0f ? (currentDistance - prevKey.Value) / delta : 0.0f;
-							//Calculate a new time based on that alpha
-							time = prevKey.Time + alpha * (key.Time - prevKey.Time);
-							//Stop iteration
-							break;
-						}
-						prevKey = key;
+						InternalTimeAccumulator = time;
 					}
 
-					StartPosition = time;
+					//Every cycle crossed adds the length of the sequence, so the play rate covers the whole distance travelled
+					const float timeJump = time - InternalTimeAccumulator + cyclesCrossed * maxTime;
+					const float deltaTime = Context.GetDeltaTime();
+					const float rateScale = Sequence->RateScale;
+					DistancePlayRate = FMath::IsNearlyZero(deltaTime) || FMath::IsNearlyZero(rateScale) ? 0.f : (timeJump / (deltaTime * rateScale));
+					CreateTickRecordForNode(Context, Sequence, bShouldLoop, DistancePlayRate);
+				}
+				else
+				{
 					InternalTimeAccumulator = time;
 				}
 			}
@@ -158,6 +254,12 @@ void FAnimNode_SequenceEvaluator::UpdateAssetPlayer(const FAnimationUpdateContex
 	TRACE_ANIM_NODE_VALUE(Context, TEXT("Sequence"), Sequence);
 	TRACE_ANIM_NODE_VALUE(Context, TEXT("InputTime"), ExplicitTime);
 	TRACE_ANIM_NODE_VALUE(Context, TEXT("Time"), InternalTimeAccumulator);
+	//Charlie - Distance Matching implementation
+	if (bShouldUseExplicityTimeAsDistanceCurveLookup && bShouldLoop)
+	{
+		TRACE_ANIM_NODE_VALUE(Context, TEXT("Distance Cycle"), DistanceLoop.CycleCount);
+	}
+	//~Charlie
 }
 
 void FAnimNode_SequenceEvaluator::Evaluate_AnyThread(FPoseContext& Output)
@@ -179,6 +281,9 @@ void FAnimNode_SequenceEvaluator::OverrideAsset(UAnimationAsset* NewAsset)
 	if(UAnimSequenceBase* NewSequence = Cast<UAnimSequenceBase>(NewAsset))
 	{
 		Sequence = NewSequence;
+		//Charlie - Distance Matching implementation
+		bDistanceCurveDirty = true;
+		//~Charlie
 	}
 }
 
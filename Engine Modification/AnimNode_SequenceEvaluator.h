@@ -6,6 +6,10 @@
 #include "UObject/ObjectMacros.h"
 #include "Animation/AnimNode_AssetPlayerBase.h"
 #include "Animation/AnimSequenceBase.h"
+//Charlie - Distance Matching implementation
+#include "Animation/SmartName.h"
+#include "AnimNodes/AnimDistanceMatching.h"
+//~Charlie
 #include "AnimNode_SequenceEvaluator.generated.h"
 
 UENUM(BlueprintType)
@@ -55,8 +59,16 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Settings, meta = (PinHiddenByDefault));
 	bool bDistanceCurveInputIsDeltaDistance;
 
+	/** Treat ExplicitTime as a speed in units per second. The distance travelled is integrated from the update's delta time, so the input does not need to be worked out in the anim blueprint */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Settings, meta = (PinHiddenByDefault));
+	bool bDistanceCurveInputIsSpeed;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Settings, meta = (PinHiddenByDefault));
 	FName DistanceCurve;
+
+	/** Accurate follows the curve's tangents between keys, so sparsely keyed curves do not slide. Fast interpolates linearly between keys */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Settings, meta = (PinHiddenByDefault));
+	EDistanceMatchingPrecision DistanceMatchingPrecision;
 	//~Charlie
 
 	/** What to do when SequenceEvaluator is reinitialized */
@@ -75,6 +87,12 @@ public:
 		, ExplicitTime(0.0f)
 		, bShouldLoop(false)
 		, bTeleportToExplicitTime(true)
+		//Charlie - Distance Matching implementation
+		, bShouldUseExplicityTimeAsDistanceCurveLookup(false)
+		, bDistanceCurveInputIsDeltaDistance(false)
+		, bDistanceCurveInputIsSpeed(false)
+		, DistanceMatchingPrecision(EDistanceMatchingPrecision::Fast)
+		//~Charlie
 		, ReinitializationBehavior(ESequenceEvalReinit::ExplicitTime)
 		, bReinitialized(false)
 		, StartPosition(0.f)
@@ -102,4 +120,45 @@ public:
 	// End of FAnimNode_AssetPlayerBase Interface
 
 	void SetExplicitPreviousTime(float PreviousTime) { InternalTimeAccumulator = PreviousTime; }
+
+	//Charlie - Distance Matching implementation
+protected:
+	/** Resolve the distance curve for the current Sequence and DistanceCurve. The segment hint and loop are only reset if either has changed */
+	void ResolveDistanceCurve();
+
+	/**
+	 * Find the time at which DistanceTable reaches this update's distance input, and move StartPosition, the segment hint and the loop on to it.
+	 * OutCyclesCrossed is the number of times the curve looped on the way, or 0 if bTeleportToDistance
+	 */
+	float MatchDistance(float DeltaTime, bool bTeleportToDistance, int32& OutCyclesCrossed);
+
+	/** True if another player led this node's sync group last update, so this node's time is set by the group rather than by its distance curve */
+	bool IsFollowingSyncGroup(const FAnimationUpdateContext& Context) const;
+
+	/** Sequence and curve name that the distance curve was last resolved for. If either pin changes, it is resolved again */
+	UAnimSequenceBase* DistanceCurveSequence = nullptr;
+	FName DistanceCurveName;
+	SmartName::UID_Type DistanceCurveUID = SmartName::MaxUID;
+	TSharedPtr<const FDistanceMatchingTable> DistanceTable;
+
+#if WITH_EDITOR
+	/** FDistanceMatchingTableCache::GetEditCount() when DistanceTable was looked up */
+	int32 DistanceTableEditCount = 0;
+#endif
+
+	/** Segment of DistanceTable found by the last update, where the next search starts */
+	int32 DistanceSegmentHint = INDEX_NONE;
+
+	/** Cycles travelled through DistanceTable when looping */
+	FDistanceMatchingLoop DistanceLoop;
+
+	/** Set when DistanceLoop is reset, so the next update moves straight to the matched time rather than playing through every cycle to it */
+	bool bDistanceLoopReset = true;
+
+	/** Play rate of the last distance matched tick record, passed on while following a sync group */
+	float DistancePlayRate = 0.f;
+
+	/** Set when the distance curve needs resolving again regardless, e.g. the asset has been overridden */
+	bool bDistanceCurveDirty = true;
+	//~Charlie
 };
@@ -2,16 +2,21 @@
 
 
 #include "CustomAnimationComponent.h"
+#include "CustomAnimationRegistry.h"
+#include "CustomAnimationMontageCache.h"
 #include "GameFramework/Actor.h"
 #include "Components/SkeletalMeshComponent.h"
 #include "Animation/AnimMontage.h"
 #include "Animation/AnimInstance.h"
+#include "Engine/AssetManager.h"
 
-const FString ContextString(TEXT("Custom Animation Context"));
 const FName OutSectionName = FName(TEXT("Out"));
 
 // Sets default values for this component's properties
 UCustomAnimationComponent::UCustomAnimationComponent()
+	: CustomAnimationDataTable(nullptr)
+	, bStreamAnimationAssets(false)
+	, NextPendingHandle(INDEX_NONE - 1)
 {
 }
 
@@ -19,42 +24,282 @@ UCustomAnimationComponent::UCustomAnimationComponent()
 // Called when the game starts
 void UCustomAnimationComponent::BeginPlay()
 {
+	Super::BeginPlay();
+
+	//Resolve the DataTable up front so the first play does not pay for building the registry
+	Registry = FCustomAnimationRegistry::Get(CustomAnimationDataTable);
+
+	//Likewise for the mesh and anim instance
+	GetTargetAnimInstance();
+}
+
+void UCustomAnimationComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	//Any loads still in flight would call back into a component that is going away
+	TArray<int32> pendingHandles;
+	PendingCustomAnimations.GetKeys(pendingHandles);
+	for (int32 pendingHandle : pendingHandles)
+	{
+		CancelPendingCustomAnimation(pendingHandle);
+	}
+
+	SetTargetMeshComponent(nullptr);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UCustomAnimationComponent::SetTargetMeshComponent(USkeletalMeshComponent* meshComponent)
+{
+	if (USkeletalMeshComponent* previousMeshComponent = CachedMeshComponent.Get())
+	{
+		previousMeshComponent->OnAnimInitialized.RemoveDynamic(this, &UCustomAnimationComponent::OnTargetAnimInitialized);
+	}
+
+	CachedMeshComponent = meshComponent;
+	CachedAnimInstance.Reset();
+
+	//Re-initialising the anim instance or swapping the anim class both go through InitializeAnimScriptInstance, which fires this
+	if (meshComponent)
+	{
+		meshComponent->OnAnimInitialized.AddUniqueDynamic(this, &UCustomAnimationComponent::OnTargetAnimInitialized);
+	}
+}
+
+USkeletalMeshComponent* UCustomAnimationComponent::GetTargetMeshComponent()
+{
+	USkeletalMeshComponent* meshComponent = CachedMeshComponent.Get();
+	if (!meshComponent)
+	{
+		AActor* owner = GetOwner();
+		if (owner)
+		{
+			//Use the explicitly referenced mesh if there is one, otherwise fall back to the first skeletal mesh on the owner
+			meshComponent = TargetMeshComponent.ComponentProperty != NAME_None
+				? Cast<USkeletalMeshComponent>(TargetMeshComponent.GetComponent(owner))
+				: owner->FindComponentByClass<USkeletalMeshComponent>();
+		}
+		SetTargetMeshComponent(meshComponent);
+	}
+	return meshComponent;
+}
+
+UAnimInstance* UCustomAnimationComponent::GetTargetAnimInstance()
+{
+	UAnimInstance* animInstance = CachedAnimInstance.Get();
+	if (!animInstance)
+	{
+		USkeletalMeshComponent* meshComponent = GetTargetMeshComponent();
+		animInstance = meshComponent ? meshComponent->GetAnimInstance() : nullptr;
+		CachedAnimInstance = animInstance;
+	}
+	return animInstance;
+}
+
+void UCustomAnimationComponent::OnTargetAnimInitialized()
+{
+	CachedAnimInstance.Reset();
+
+	//The montage instances of the previous anim instance are destroyed without OnMontageEnded being called, so forget their IDs here.
+	//Otherwise they would stay in the maps, and stopping by name would go looking for instances that no longer exist
+	MontageIdNameMap.Reset();
+	ActiveInstanceIdMap.Reset();
 }
 
 int32 UCustomAnimationComponent::PlayCustomAnimation(FName customAnimationName, int32 numLoops, FName slot, bool freezeOnLastFrame)
 {
-	//Attempts to get pointer to the animation asset
-	TSoftObjectPtr<UAnimSequenceBase> animationAsset = GetAssetPtrForName(customAnimationName);
+	//Attempts to find the custom animation in the registry
+	const int32 registryIndex = FindCustomAnimationIndex(customAnimationName);
+
+	int32 instanceId = INDEX_NONE;
+	PlayRegistryEntry(registryIndex, numLoops, slot, freezeOnLastFrame, instanceId);
+	return instanceId;
+}
+
+ECustomAnimationPlayResult UCustomAnimationComponent::PlayRegistryEntry(int32 registryIndex, int32 numLoops, const FName& slot, bool freezeOnLastFrame, int32& outInstanceId)
+{
+	outInstanceId = INDEX_NONE;
 
-	if (!animationAsset.IsNull())
+	if (registryIndex == INDEX_NONE)
 	{
-		USkeletalMeshComponent* meshComponent = GetOwner()->FindComponentByClass<USkeletalMeshComponent>();
-		if (meshComponent)
+		return ECustomAnimationPlayResult::NotFound;
+	}
+
+	const FCustomAnimationRegistryEntry& entry = Registry->GetEntry(registryIndex);
+	const FName& customAnimationName = entry.CustomAnimationName;
+	const TSoftObjectPtr<UAnimSequenceBase>& animationAsset = entry.AnimationAsset;
+
+	if (animationAsset.IsNull())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Animation asset for custom animation %s in Datatable %s has not been assigned"), *(customAnimationName.ToString()), *GetNameSafe(CustomAnimationDataTable));
+		return ECustomAnimationPlayResult::AssetNotAssigned;
+	}
+
+	UAnimInstance* animInstance = GetTargetAnimInstance();
+	if (!animInstance)
+	{
+		return ECustomAnimationPlayResult::NoAnimInstance;
+	}
+
+	//If the animation has not yet been loaded, either stream it in and play it on arrival, or load it now and then play it
+	if (animationAsset.IsPending())
+	{
+		if (bStreamAnimationAssets)
 		{
-			UAnimInstance* animInstance = meshComponent->GetAnimInstance();
-			if (animInstance)
-			{
-				//If the animation has not yet been loaded, load it, and then play it
-				if (animationAsset.IsPending())
-				{
-					//TODO::Change to async load
-					animationAsset.LoadSynchronous();
-					return PlayAnimationAsset(animInstance, animationAsset.Get(), numLoops, customAnimationName, slot, freezeOnLastFrame);
-				}
-				//If the animation has already been loaded, play it
-				else if (animationAsset.IsValid())
-				{
-					return PlayAnimationAsset(animInstance, animationAsset.Get(), numLoops, customAnimationName, slot, freezeOnLastFrame);
-				}
-			}
+			outInstanceId = RequestAsyncCustomAnimation(animationAsset, customAnimationName, numLoops, slot, freezeOnLastFrame);
+			return ECustomAnimationPlayResult::Pending;
+		}
+
+		animationAsset.LoadSynchronous();
+	}
+
+	//If the animation has been loaded, play it
+	UAnimSequenceBase* asset = animationAsset.Get();
+	if (!asset)
+	{
+		return ECustomAnimationPlayResult::LoadFailed;
+	}
+
+	outInstanceId = PlayAnimationAsset(animInstance, asset, numLoops, customAnimationName, slot, freezeOnLastFrame);
+	return outInstanceId != INDEX_NONE ? ECustomAnimationPlayResult::Success : ECustomAnimationPlayResult::PlayFailed;
+}
+
+void UCustomAnimationComponent::PlayCustomAnimationBatch(const TArray<FCustomAnimationPlayRequest>& requests, TArray<FCustomAnimationPlayResult>& results)
+{
+	results.SetNum(requests.Num());
+
+	//Mass triggers tend to play the same animation on many components sharing one DataTable,
+	//so the registry lookup is only repeated when the registry or the name changes between requests
+	const FCustomAnimationRegistry* lastRegistry = nullptr;
+	FName lastName = NAME_None;
+	int32 lastIndex = INDEX_NONE;
+
+	for (int32 requestIndex = 0; requestIndex < requests.Num(); ++requestIndex)
+	{
+		const FCustomAnimationPlayRequest& request = requests[requestIndex];
+		FCustomAnimationPlayResult& result = results[requestIndex];
+
+		UCustomAnimationComponent* component = request.Component;
+		if (!IsValid(component))
+		{
+			result.MontageInstanceID = INDEX_NONE;
+			result.Result = ECustomAnimationPlayResult::InvalidComponent;
+			continue;
+		}
+
+		int32 registryIndex = lastIndex;
+		const FCustomAnimationRegistry* registry = component->Registry.Get();
+		if (!registry || registry != lastRegistry || request.CustomAnimationName != lastName || registry->GetDataTable() != component->CustomAnimationDataTable)
+		{
+			registryIndex = component->FindCustomAnimationIndex(request.CustomAnimationName);
+			lastRegistry = component->Registry.Get();
+			lastName = request.CustomAnimationName;
+			lastIndex = registryIndex;
+		}
+
+		result.Result = component->PlayRegistryEntry(registryIndex, request.NumLoops, request.Slot, request.bFreezeOnLastFrame, result.MontageInstanceID);
+	}
+}
+
+void UCustomAnimationComponent::StopCustomAnimationBatch(const TArray<FCustomAnimationStopRequest>& requests, CustomAnimationStopMode stopMode, bool blendOut, bool useOutSection, bool freezeOnLastFrame, bool newestOnly)
+{
+	for (const FCustomAnimationStopRequest& request : requests)
+	{
+		if (IsValid(request.Component))
+		{
+			request.Component->StopCustomAnimation(request.CustomAnimationName, stopMode, blendOut, useOutSection, freezeOnLastFrame, newestOnly);
+		}
+	}
+}
+
+int32 UCustomAnimationComponent::RequestAsyncCustomAnimation(const TSoftObjectPtr<UAnimSequenceBase>& animationAsset, const FName& customAnimationName, int32 numLoops, const FName& slot, bool freezeOnLastFrame)
+{
+	const int32 pendingHandle = NextPendingHandle--;
+
+	//Add the entry before issuing the request, so that a load which completes straight away can still find it
+	FPendingCustomAnimation& pending = PendingCustomAnimations.Add(pendingHandle);
+	pending.CustomAnimationName = customAnimationName;
+	pending.AnimationAsset = animationAsset;
+	pending.NumLoops = numLoops;
+	pending.Slot = slot;
+	pending.bFreezeOnLastFrame = freezeOnLastFrame;
+	pending.RequestTime = FPlatformTime::Seconds();
+	LoadStats.NumRequests++;
+
+	TSharedPtr<FStreamableHandle> loadHandle = UAssetManager::GetStreamableManager().RequestAsyncLoad(animationAsset.ToSoftObjectPath(),
+		FStreamableDelegate::CreateUObject(this, &UCustomAnimationComponent::OnCustomAnimationAssetLoaded, pendingHandle));
+
+	//The map may have been modified by the completion callback, so look the entry up again
+	if (FPendingCustomAnimation* stillPending = PendingCustomAnimations.Find(pendingHandle))
+	{
+		stillPending->LoadHandle = loadHandle;
+	}
+
+	return pendingHandle;
+}
+
+void UCustomAnimationComponent::OnCustomAnimationAssetLoaded(int32 pendingHandle)
+{
+	FPendingCustomAnimation pending;
+	//If the entry is gone, the request was cancelled while the asset was in flight
+	if (!PendingCustomAnimations.RemoveAndCopyValue(pendingHandle, pending))
+	{
+		return;
+	}
+
+	const float latencyMs = (float)((FPlatformTime::Seconds() - pending.RequestTime) * 1000.0);
+	LoadStats.NumCompleted++;
+	LoadStats.LastLatencyMs = latencyMs;
+	LoadStats.MaxLatencyMs = FMath::Max(LoadStats.MaxLatencyMs, latencyMs);
+	LoadStats.AverageLatencyMs += (latencyMs - LoadStats.AverageLatencyMs) / LoadStats.NumCompleted;
+
+	int32 montageInstanceId = INDEX_NONE;
+	UAnimSequenceBase* asset = pending.AnimationAsset.Get();
+	if (asset)
+	{
+		//The cached binding is invalidated if the anim instance changed while the asset was loading
+		UAnimInstance* animInstance = GetTargetAnimInstance();
+		if (animInstance)
+		{
+			montageInstanceId = PlayAnimationAsset(animInstance, asset, pending.NumLoops, pending.CustomAnimationName, pending.Slot, pending.bFreezeOnLastFrame);
 		}
 	}
 	else
 	{
-		UE_LOG(LogTemp, Warning, TEXT("Animation asset for custom animation %s in Datatable %s has not been assigned"), *(customAnimationName.ToString()), *(CustomAnimationDataTable->GetName()));
+		UE_LOG(LogTemp, Warning, TEXT("Failed to stream in animation asset for custom animation %s"), *(pending.CustomAnimationName.ToString()));
 	}
 
-	return INDEX_NONE;
+	OnCustomAnimationStarted.Broadcast(pending.CustomAnimationName, pendingHandle, montageInstanceId);
+}
+
+int32 UCustomAnimationComponent::CancelPendingCustomAnimations(const FName& customAnimationName)
+{
+	TArray<int32, TInlineAllocator<4>> pendingHandles;
+	for (const TPair<int32, FPendingCustomAnimation>& pair : PendingCustomAnimations)
+	{
+		if (pair.Value.CustomAnimationName == customAnimationName)
+		{
+			pendingHandles.Add(pair.Key);
+		}
+	}
+
+	for (int32 pendingHandle : pendingHandles)
+	{
+		CancelPendingCustomAnimation(pendingHandle);
+	}
+	return pendingHandles.Num();
+}
+
+void UCustomAnimationComponent::CancelPendingCustomAnimation(int32 pendingHandle)
+{
+	FPendingCustomAnimation pending;
+	if (PendingCustomAnimations.RemoveAndCopyValue(pendingHandle, pending))
+	{
+		if (pending.LoadHandle.IsValid())
+		{
+			pending.LoadHandle->CancelHandle();
+		}
+		LoadStats.NumCancelled++;
+	}
 }
 
 int32 UCustomAnimationComponent::PlayAnimationAsset(UAnimInstance* animInstance, UAnimSequenceBase* asset, int32 numLoops, const FName& customAnimationName, const FName& slot, const bool freezeOnLastFrame)
@@ -74,13 +319,17 @@ int32 UCustomAnimationComponent::PlayAnimationAsset(UAnimInstance* animInstance,
 	}
 	else
 	{
-		montage = animInstance->PlaySlotAnimationAsDynamicMontage(asset, slot, 0.25f, 0.25f, 1.0f, numLoops);
-		montageInstance = animInstance->GetActiveInstanceForMontage(montage);
+		//Dynamic montages are shared with every other play of this sequence, so the loop count is set on the montage instance instead
+		montage = FCustomAnimationMontageCache::Get().FindOrCreateDynamicMontage(asset, slot);
+		if (montage && animInstance->Montage_Play(montage, 1.0f, EMontagePlayReturnType::MontageLength, 0.0f, true, numLoops) > 0.0f)
+		{
+			montageInstance = animInstance->GetActiveInstanceForMontage(montage);
+		}
 
-		//If a montge instance was successfully created for this dynamic motage, add the source montage to the map for future lookup
+		//Dynamic montages only have the one section, which is the one that loops
 		if (montageInstance)
 		{
-			DynamicMontageMap.Add(customAnimationName, montage);
+			montageInstance->CustomAnimationLoopingSectionOverride = 0;
 		}
 	}
 
@@ -88,6 +337,7 @@ int32 UCustomAnimationComponent::PlayAnimationAsset(UAnimInstance* animInstance,
 	if (montage && montageInstance)
 	{
 		MontageIdNameMap.Add(montageInstance->GetInstanceID(), customAnimationName);
+		ActiveInstanceIdMap.FindOrAdd(customAnimationName).Add(montageInstance->GetInstanceID());
 		montageInstance->OnMontageEnded.BindUObject(this, &UCustomAnimationComponent::OnMontageEnded, montageInstance->GetInstanceID());
 		montageInstance->OnMontageSectionEnded.BindUObject(this, &UCustomAnimationComponent::OnMontageSectionEnded);
 		montageInstance->bEnableAutoBlendOut = !freezeOnLastFrame;
@@ -97,183 +347,207 @@ int32 UCustomAnimationComponent::PlayAnimationAsset(UAnimInstance* animInstance,
 	return INDEX_NONE;
 }
 
-void UCustomAnimationComponent::StopCustomAnimation(FName customAnimationName, CustomAnimationStopMode stopMode, bool blendOut, bool useOutSection, bool freezeOnLastFrame)
+FCustomAnimationDynamicMontageStats UCustomAnimationComponent::GetCustomAnimationDynamicMontageStats()
 {
-	//Get the mesh component. Make sure there is an active anim instance
-	USkeletalMeshComponent* meshComponent = GetOwner()->FindComponentByClass<USkeletalMeshComponent>();
-	if (meshComponent)
+	const FCustomAnimationMontageCache& cache = FCustomAnimationMontageCache::Get();
+
+	FCustomAnimationDynamicMontageStats stats;
+	stats.NumHits = cache.GetNumHits();
+	stats.NumMisses = cache.GetNumMisses();
+	stats.NumSharedMontages = cache.GetNumSharedMontages();
+	stats.SharedMontageBytes = (int64)cache.GetSharedMontageBytes();
+	stats.BytesPerMontage = stats.NumSharedMontages > 0 ? stats.SharedMontageBytes / stats.NumSharedMontages : 0;
+	return stats;
+}
+
+void UCustomAnimationComponent::StopCustomAnimation(FName customAnimationName, CustomAnimationStopMode stopMode, bool blendOut, bool useOutSection, bool freezeOnLastFrame, bool newestOnly)
+{
+	//Anything of this name that is still streaming in should never start playing
+	const int32 numCancelled = CancelPendingCustomAnimations(customAnimationName);
+
+	//Make sure there is an active anim instance
+	UAnimInstance* animInstance = GetTargetAnimInstance();
+	if (animInstance)
 	{
-		UAnimInstance* animInstance = meshComponent->GetAnimInstance();
-		if (animInstance)
+		const TArray<int32, TInlineAllocator<2>>* instanceIds = ActiveInstanceIdMap.Find(customAnimationName);
+		if (!instanceIds)
 		{
-			//Look up  the custom animation in the dynamic montage map
-			UAnimMontage* montage = nullptr;
-			montage = DynamicMontageMap.FindRef(customAnimationName);
-			if (montage)
+			//Cancelling a play that was still streaming in counts as stopping it
+			if (numCancelled == 0)
 			{
-				StopDynamicMontage(montage, animInstance, stopMode, blendOut, freezeOnLastFrame);
-				return;
+				UE_LOG(LogTemp, Warning, TEXT("Attempting to stop Custom Animation %s in the DataTable %s but it is not playing"), *(customAnimationName.ToString()), *GetNameSafe(CustomAnimationDataTable));
 			}
-			//If the custom anim was not found above, attempt to find it via the custom anim database
-			if (!montage)
+			return;
+		}
+
+		if (newestOnly)
+		{
+			//Instances stay in the map until they have finished blending out, so skip any that have already been stopped
+			for (int32 index = instanceIds->Num() - 1; index >= 0; --index)
 			{
-				TSoftObjectPtr<UAnimSequenceBase> animationAsset = GetAssetPtrForName(customAnimationName);
-				//If the asset is currently pending, it has not yet been loaded
-				if (animationAsset.IsPending())
-				{
-					UE_LOG(LogTemp, Warning, TEXT("Attempting to stop Custom Animation %s in the DataTable %s but it has not yet been loaded"), *(customAnimationName.ToString()), *(CustomAnimationDataTable->GetName()));
-				}
-				else if (animationAsset.IsValid())
+				const int32 montageInstanceId = (*instanceIds)[index];
+				FAnimMontageInstance* montageInstance = animInstance->GetMontageInstanceForID(montageInstanceId);
+				if (montageInstance && !montageInstance->IsStopped())
 				{
-					//At this point it is expected that the asset is probably a montage, however it could be the case that it is a sequence
-					//if the stop call has been called on a sequence that has not yet been played. Check for this
-
-					UAnimSequenceBase* asset = animationAsset.Get();
-					if (asset->IsA(UAnimMontage::StaticClass()))
-					{
-						montage = CastChecked<UAnimMontage>(asset);
-						if (montage)
-						{
-							StopDatatableMontage(montage, animInstance, stopMode, blendOut, useOutSection, freezeOnLastFrame);
-						}
-					}
-					else
-					{
-						UE_LOG(LogTemp, Warning, TEXT("Attempting to stop Custom Animation %s in the DataTable %s but it has not yet been played"), *(customAnimationName.ToString()), *(CustomAnimationDataTable->GetName()));
-					}
+					StopMontageInstance(montageInstanceId, animInstance, stopMode, blendOut, useOutSection, freezeOnLastFrame);
+					break;
 				}
 			}
 		}
+		else
+		{
+			//Copy the IDs, in case stopping an instance ends it straight away and removes it from the map. Any that are already stopping are skipped
+			const TArray<int32, TInlineAllocator<2>> montageInstanceIds = *instanceIds;
+			for (int32 montageInstanceId : montageInstanceIds)
+			{
+				StopMontageInstance(montageInstanceId, animInstance, stopMode, blendOut, useOutSection, freezeOnLastFrame);
+			}
+		}
 	}
 }
 
-void UCustomAnimationComponent::StopDynamicMontage(UAnimMontage* montage, UAnimInstance* animInstance, CustomAnimationStopMode stopMode, bool blendOut, bool freezeOnLastFrame)
+void UCustomAnimationComponent::StopCustomAnimationInstance(int32 montageInstanceId, CustomAnimationStopMode stopMode, bool blendOut, bool useOutSection, bool freezeOnLastFrame)
+{
+	//PlayCustomAnimation hands out a pending handle in place of an instance ID while the asset streams in
+	if (PendingCustomAnimations.Contains(montageInstanceId))
+	{
+		CancelPendingCustomAnimation(montageInstanceId);
+		return;
+	}
+
+	if (!MontageIdNameMap.Contains(montageInstanceId))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to stop Custom Animation instance %d but it is not playing"), montageInstanceId);
+		return;
+	}
+
+	UAnimInstance* animInstance = GetTargetAnimInstance();
+	if (animInstance)
+	{
+		StopMontageInstance(montageInstanceId, animInstance, stopMode, blendOut, useOutSection, freezeOnLastFrame);
+	}
+}
+
+void UCustomAnimationComponent::StopMontageInstance(int32 montageInstanceId, UAnimInstance* animInstance, CustomAnimationStopMode stopMode, bool blendOut, bool useOutSection, bool freezeOnLastFrame)
+{
+	//Instances stay around until they have finished blending out. Stopping one again would restart its blend, and jump back to its out section
+	FAnimMontageInstance* montageInstance = animInstance->GetMontageInstanceForID(montageInstanceId);
+	if (!montageInstance || !montageInstance->IsValid() || montageInstance->IsStopped())
+	{
+		return;
+	}
+
+	//Only sequences played through a dynamic montage are given a looping section override (see PlayAnimationAsset)
+	if (montageInstance->CustomAnimationLoopingSectionOverride != INDEX_NONE)
+	{
+		StopDynamicMontage(montageInstance, animInstance, stopMode, blendOut, freezeOnLastFrame);
+		return;
+	}
+
+	//The montage keeps its out section index up to date, including through edits
+	StopDatatableMontage(montageInstance, animInstance, stopMode, blendOut, useOutSection, freezeOnLastFrame, montageInstance->Montage->GetOutSectionIndex());
+}
+
+void UCustomAnimationComponent::StopDynamicMontage(FAnimMontageInstance* montageInstance, UAnimInstance* animInstance, CustomAnimationStopMode stopMode, bool blendOut, bool freezeOnLastFrame)
 {
 	/*
 	Used for stopping custom animations that were converted into dynamic montages when originally played.
 	These animations will be of "anim sequence" type in the data table
 	*/
 
-	if (montage)
+	//Dynamic montages are shared, so everything here is done on the montage instance and the montage itself is never modified.
+	//Note: A dynamic montage will only have one section (0), whose loops are driven by the instance
+	if (montageInstance && montageInstance->IsValid())
 	{
-		//As the montage was found within the dynamic montage map, it means that we need to edit the loop variable within the montage class itself,
-		//rather than the montage instance.
-		//Note: A dynamic montage will only have one slot track (0)
-		if (montage->SlotAnimTracks.IsValidIndex(0))
-		{
-			if (montage->SlotAnimTracks[0].AnimTrack.AnimSegments.IsValidIndex(0))
-			{
-				//Get Montage Instance
-				FAnimMontageInstance* montageInstance = animInstance->GetActiveInstanceForMontage(montage);
-				if (montageInstance)
-				{
-					montageInstance->bEnableAutoBlendOut = !freezeOnLastFrame;
-
-					switch (stopMode)
-					{
-					case StopMode_Immediate:
-					{
-						float blendOutTime = blendOut ? montage->BlendOut.GetBlendTime() : 0.0f;
-						animInstance->Montage_Stop(blendOutTime, montage);
-						break;
-					}
-					//The dynamic montages do not have an "out" section, so nstead if this is selected
-					//we should just let them finish their loop
-					case StopMode_OnCurrentSectionEnd:
-					{
-						//Set the looping count on the base montage object to be 1
-						montage->SlotAnimTracks[0].AnimTrack.AnimSegments[0].LoopingCount = 1;
-						//Get the new length of the ontage
-						float newSequenceLength = montage->SlotAnimTracks[0].AnimTrack.AnimSegments[0].GetLength();
-						//Get the current position of th emontage instance (Current pos = play time)
-						float modPosition = montageInstance->GetPosition();
-						//FMod with the new length to get a new play position that should be equivalent to the old one, but appropriate to the new lengths
-						modPosition = fmod(modPosition, newSequenceLength);
-						//Set the new play position
-						montageInstance->SetPosition(modPosition);
-						//Update the length of the base montage to be the newly calculated length
-						montage->SequenceLength = newSequenceLength;
-						break;
-					}
-					default:
-						UE_LOG(LogTemp, Warning, TEXT("Attempting to stop Custom Animation with invalid Stop Mode"));
-						break;
-					}
-				}
+		montageInstance->bEnableAutoBlendOut = !freezeOnLastFrame;
 
-			}
+		switch (stopMode)
+		{
+		case StopMode_Immediate:
+		{
+			float blendOutTime = blendOut ? montageInstance->Montage->BlendOut.GetBlendTime() : 0.0f;
+			animInstance->Montage_StopInstance(montageInstance->GetInstanceID(), blendOutTime);
+			break;
+		}
+		//The dynamic montages do not have an "out" section, so nstead if this is selected
+		//we should just let them finish their loop
+		case StopMode_OnCurrentSectionEnd:
+		{
+			//Clear the remaining loops, and undo the self-link used for infinite loops, so the montage ends with the current loop
+			montageInstance->CustomAnimationLoopingSectionLoops = 0;
+			montageInstance->SetNextSectionID(0, INDEX_NONE);
+			break;
+		}
+		default:
+			UE_LOG(LogTemp, Warning, TEXT("Attempting to stop Custom Animation with invalid Stop Mode"));
+			break;
 		}
 	}
 }
 
-void UCustomAnimationComponent::StopDatatableMontage(UAnimMontage* montage, UAnimInstance* animInstance, CustomAnimationStopMode stopMode, bool blendOut, bool useOutSection, bool freezeOnLastFrame)
+void UCustomAnimationComponent::StopDatatableMontage(FAnimMontageInstance* montageInstance, UAnimInstance* animInstance, CustomAnimationStopMode stopMode, bool blendOut, bool useOutSection, bool freezeOnLastFrame, int32 endSectionIndex)
 {
 	/*
 	This method is for stopping custom animations that were stored in the data table as montages
 	*/
 
-	if (montage && animInstance)
+	if (montageInstance && montageInstance->IsValid() && animInstance)
 	{
-		//Attempt to get the montage instance for this montage
-		FAnimMontageInstance* montageInstance = animInstance->GetActiveInstanceForMontage(montage);
-		if (montageInstance)
-		{
-			montageInstance->bEnableAutoBlendOut = !freezeOnLastFrame;
+		UAnimMontage* montage = montageInstance->Montage;
+		montageInstance->bEnableAutoBlendOut = !freezeOnLastFrame;
 
-			int32 currentSecctionIndex = montage->GetSectionIndex(montageInstance->GetCurrentSection());
-			int32 endSectionIndex = montage->GetSectionIndex(OutSectionName);
+		int32 currentSecctionIndex = montage->GetSectionIndex(montageInstance->GetCurrentSection());
 
-			//The montage *should* have an out section, but if it doesn't then change the stop mode
-			//so that we will not try to use it. Print warning
-			if (useOutSection && endSectionIndex == INDEX_NONE)
-			{
-				useOutSection = false;
-				UE_LOG(LogTemp, Warning, TEXT("Attempting to stop custom animation %s by using 'Out section', but it does not exist"), *(montage->GetName()));
-			}
+		//The montage *should* have an out section, but if it doesn't then change the stop mode
+		//so that we will not try to use it. Print warning
+		if (useOutSection && endSectionIndex == INDEX_NONE)
+		{
+			useOutSection = false;
+			UE_LOG(LogTemp, Warning, TEXT("Attempting to stop custom animation %s by using 'Out section', but it does not exist"), *(montage->GetName()));
+		}
 
-			montageInstance->bCustomAnimationBlendOut = blendOut;
+		montageInstance->bCustomAnimationBlendOut = blendOut;
 
-			switch (stopMode)
+		switch (stopMode)
+		{
+		case StopMode_Immediate:
+		{
+			//If we want to exit the montage right now, but also want to use the out section
+			if (useOutSection)
 			{
-			case StopMode_Immediate:
+				montageInstance->JumpToSectionName(OutSectionName);
+			}
+			//If we want to exit the montage right now without using the out section
+			else
 			{
-				//If we want to exit the montage right now, but also want to use the out section
-				if (useOutSection)
-				{
-					montageInstance->JumpToSectionName("Out");
-				}
-				//If we want to exit the montage right now without using the out section
-				else
-				{
-					float blendOutTime = blendOut ? montage->BlendOut.GetBlendTime() : 0.0f;
-					animInstance->Montage_Stop(blendOutTime, montage);
-				}
-				break;
+				float blendOutTime = blendOut ? montage->BlendOut.GetBlendTime() : 0.0f;
+				animInstance->Montage_StopInstance(montageInstance->GetInstanceID(), blendOutTime);
 			}
-			case StopMode_OnCurrentSectionEnd:
+			break;
+		}
+		case StopMode_OnCurrentSectionEnd:
+		{
+			montageInstance->CustomAnimationLoopingSectionLoops = 0;
+			//If we want to exit the montage when the current section finishes, and want to use the out section
+			if (useOutSection)
 			{
-				montageInstance->CustomAnimationLoopingSectionLoops = 0;
-				//If we want to exit the montage when the current section finishes, and want to use the out section
-				if (useOutSection)
-				{
-					montageInstance->SetNextSectionID(currentSecctionIndex, endSectionIndex);
-				}
-				//If we want to exit the montage when the current section finished, but do not want to use the out section
-				else
-				{
-					montageInstance->SetNextSectionID(currentSecctionIndex, -1);
-				}
-				break;
+				montageInstance->SetNextSectionID(currentSecctionIndex, endSectionIndex);
 			}
-			default:
-				break;
+			//If we want to exit the montage when the current section finished, but do not want to use the out section
+			else
+			{
+				montageInstance->SetNextSectionID(currentSecctionIndex, -1);
 			}
+			break;
 		}
-		else
-		{
-			UE_LOG(LogTemp, Warning, TEXT("Attempting to stop Custom Animation %s but there is no assigned montage instance."), *(montage->GetName()));
+		default:
+			break;
 		}
 	}
+	else
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to stop Custom Animation but there is no assigned montage instance."));
+	}
 }
 
 void UCustomAnimationComponent::OnMontageEnded(UAnimMontage* Montage, bool bInterrupted, int32 MontageInstanceId)
@@ -284,8 +558,15 @@ void UCustomAnimationComponent::OnMontageEnded(UAnimMontage* Montage, bool bInte
 	//Find and remove the name of the custom Anim
 	FName customAnimationName = MontageIdNameMap.FindAndRemoveChecked(MontageInstanceId);
 
-	//Find and remove from the dynamic map
-	DynamicMontageMap.Remove(customAnimationName);
+	//Find and remove from the active instances of this custom anim
+	if (TArray<int32, TInlineAllocator<2>>* instanceIds = ActiveInstanceIdMap.Find(customAnimationName))
+	{
+		instanceIds->RemoveSingle(MontageInstanceId);
+		if (instanceIds->Num() == 0)
+		{
+			ActiveInstanceIdMap.Remove(customAnimationName);
+		}
+	}
 
 	OnCustomAnimationEnded.Broadcast(customAnimationName, MontageInstanceId);
 }
@@ -307,16 +588,23 @@ void UCustomAnimationComponent::OnMontageSectionEnded(UAnimMontage* Montage, int
 	}
 }
 
-TSoftObjectPtr<UAnimSequenceBase> UCustomAnimationComponent::GetAssetPtrForName(const FName& customAnimationName)
+int32 UCustomAnimationComponent::FindCustomAnimationIndex(const FName& customAnimationName)
 {
-	FCustomAnimationStructure* tableRow = CustomAnimationDataTable->FindRow<FCustomAnimationStructure>(customAnimationName, ContextString, true);
-	if (tableRow)
+	//The registry is normally acquired in BeginPlay, but the DataTable can be reassigned at any time
+	if (!Registry.IsValid() || Registry->GetDataTable() != CustomAnimationDataTable)
 	{
-		return tableRow->AnimationAsset;
+		Registry = FCustomAnimationRegistry::Get(CustomAnimationDataTable);
+		if (!Registry.IsValid())
+		{
+			UE_LOG(LogTemp, Warning, TEXT("No Datatable assigned when looking up Custom Animation %s"), *(customAnimationName.ToString()));
+			return INDEX_NONE;
+		}
 	}
-	else
+
+	const int32 registryIndex = Registry->FindIndex(customAnimationName);
+	if (registryIndex == INDEX_NONE)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("Row not found for Custom Animation %s in Datatable %s"), *(customAnimationName.ToString()), *(CustomAnimationDataTable->GetName()));
+		UE_LOG(LogTemp, Warning, TEXT("Row not found for Custom Animation %s in Datatable %s"), *(customAnimationName.ToString()), *GetNameSafe(CustomAnimationDataTable));
 	}
-	return nullptr;
-}
\ No newline at end of file
+	return registryIndex;
+}
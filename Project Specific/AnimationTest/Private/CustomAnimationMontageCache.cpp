@@ -0,0 +1,102 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CustomAnimationMontageCache.h"
+#include "Animation/AnimMontage.h"
+#include "HAL/IConsoleManager.h"
+
+static int32 GCustomAnimationMontageCacheSize = 32;
+static FAutoConsoleVariableRef CVarCustomAnimationMontageCacheSize(
+	TEXT("a.CustomAnimation.MontageCacheSize"),
+	GCustomAnimationMontageCacheSize,
+	TEXT("Number of recently played dynamic montages that are kept alive while nothing is playing them. 0 keeps none, so idle montages are rebuilt after every garbage collection"),
+	ECVF_Default);
+
+FCustomAnimationMontageCache& FCustomAnimationMontageCache::Get()
+{
+	static FCustomAnimationMontageCache Cache;
+	return Cache;
+}
+
+UAnimMontage* FCustomAnimationMontageCache::FindOrCreateDynamicMontage(UAnimSequenceBase* sequence, const FName& slot)
+{
+	FKey key;
+	key.Sequence = FObjectKey(sequence);
+	key.Slot = slot;
+
+	if (const TWeakObjectPtr<UAnimMontage>* cachedMontage = DynamicMontages.Find(key))
+	{
+		if (UAnimMontage* montage = cachedMontage->Get())
+		{
+			NumHits++;
+			MarkRecentlyUsed(montage);
+			return montage;
+		}
+	}
+
+	NumMisses++;
+
+	//Misses are the only time the map grows, so this is where montages that have since been collected are cleared out
+	RemoveStaleMontages();
+
+	//Built with a single loop. The number of loops is set on each montage instance through CustomAnimationLoopingSectionOverride
+	UAnimMontage* montage = UAnimMontage::CreateSlotAnimationAsDynamicMontage(sequence, slot, 0.25f, 0.25f, 1.0f, 1);
+	if (montage)
+	{
+		DynamicMontages.Add(key, montage);
+		MarkRecentlyUsed(montage);
+	}
+	return montage;
+}
+
+void FCustomAnimationMontageCache::MarkRecentlyUsed(UAnimMontage* montage)
+{
+	//The list is short, so a linear search is cheaper than keeping a map alongside it
+	RecentMontages.RemoveSingle(montage);
+	RecentMontages.Add(montage);
+
+	const int32 numToDrop = RecentMontages.Num() - FMath::Max(GCustomAnimationMontageCacheSize, 0);
+	if (numToDrop > 0)
+	{
+		RecentMontages.RemoveAt(0, numToDrop, false);
+	}
+}
+
+void FCustomAnimationMontageCache::AddReferencedObjects(FReferenceCollector& Collector)
+{
+	Collector.AddReferencedObjects(RecentMontages);
+}
+
+void FCustomAnimationMontageCache::RemoveStaleMontages()
+{
+	for (auto it = DynamicMontages.CreateIterator(); it; ++it)
+	{
+		if (!it.Value().IsValid())
+		{
+			it.RemoveCurrent();
+		}
+	}
+}
+
+int32 FCustomAnimationMontageCache::GetNumSharedMontages() const
+{
+	int32 numMontages = 0;
+	for (const TPair<FKey, TWeakObjectPtr<UAnimMontage>>& pair : DynamicMontages)
+	{
+		numMontages += pair.Value.IsValid() ? 1 : 0;
+	}
+	return numMontages;
+}
+
+SIZE_T FCustomAnimationMontageCache::GetSharedMontageBytes() const
+{
+	SIZE_T bytes = 0;
+	for (const TPair<FKey, TWeakObjectPtr<UAnimMontage>>& pair : DynamicMontages)
+	{
+		if (UAnimMontage* montage = pair.Value.Get())
+		{
+			bytes += montage->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+		}
+	}
+	return bytes;
+}
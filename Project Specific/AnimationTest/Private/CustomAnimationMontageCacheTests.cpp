@@ -0,0 +1,56 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "UObject/Package.h"
+#include "Animation/AnimSequence.h"
+#include "Animation/AnimMontage.h"
+#include "CustomAnimationMontageCache.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCustomAnimationMontageCacheMemoryTest, "Project.CustomAnimation.MontageCache.Memory", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FCustomAnimationMontageCacheMemoryTest::RunTest(const FString& Parameters)
+{
+	//1k actors all playing the same idle sequence
+	const int32 numActors = 1000;
+	const FName slot(TEXT("DefaultSlot"));
+	UAnimSequence* sequence = NewObject<UAnimSequence>(GetTransientPackage());
+	sequence->SequenceLength = 2.0f;
+
+	//Before montages were shared, every play built its own dynamic montage
+	SIZE_T perPlayBytes = 0;
+	int32 numPerPlayMontages = 0;
+	for (int32 actorIndex = 0; actorIndex < numActors; ++actorIndex)
+	{
+		if (UAnimMontage* montage = UAnimMontage::CreateSlotAnimationAsDynamicMontage(sequence, slot, 0.25f, 0.25f, 1.0f, 1))
+		{
+			perPlayBytes += montage->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+			numPerPlayMontages++;
+		}
+	}
+
+	//A cache of its own, so the counts are not mixed up with anything else that has played
+	FCustomAnimationMontageCache cache;
+	for (int32 actorIndex = 0; actorIndex < numActors; ++actorIndex)
+	{
+		cache.FindOrCreateDynamicMontage(sequence, slot);
+	}
+	const SIZE_T sharedBytes = cache.GetSharedMontageBytes();
+
+	TestEqual(TEXT("Montages built per play"), numPerPlayMontages, numActors);
+	TestEqual(TEXT("Shared montages"), cache.GetNumSharedMontages(), 1);
+	TestEqual(TEXT("Cache misses"), cache.GetNumMisses(), 1);
+	TestEqual(TEXT("Cache hits"), cache.GetNumHits(), numActors - 1);
+	TestTrue(TEXT("Shared montages use less memory than a montage per play"), sharedBytes < perPlayBytes);
+
+	//Loop counts live on the montage instances either way, so the montages are the whole difference
+	AddInfo(FString::Printf(TEXT("%d actors: %d montages and %llu bytes with a montage per play, %d montage and %llu bytes shared"),
+		numActors, numPerPlayMontages, (uint64)perPlayBytes, cache.GetNumSharedMontages(), (uint64)sharedBytes));
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,80 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CustomAnimationRegistry.h"
+#include "CustomAnimationComponent.h"
+#include "Engine/DataTable.h"
+
+namespace CustomAnimationRegistry
+{
+	//Registries are owned by the components using them. Only weak references are held here so a registry dies with its last user
+	TMap<TWeakObjectPtr<UDataTable>, TWeakPtr<FCustomAnimationRegistry>> RegistryMap;
+}
+
+TSharedPtr<FCustomAnimationRegistry> FCustomAnimationRegistry::Get(UDataTable* dataTable)
+{
+	if (!dataTable)
+	{
+		return nullptr;
+	}
+
+	TWeakPtr<FCustomAnimationRegistry>& weakRegistry = CustomAnimationRegistry::RegistryMap.FindOrAdd(dataTable);
+	TSharedPtr<FCustomAnimationRegistry> registry = weakRegistry.Pin();
+	if (!registry.IsValid())
+	{
+		registry = MakeShareable(new FCustomAnimationRegistry(dataTable));
+		weakRegistry = registry;
+	}
+	return registry;
+}
+
+FCustomAnimationRegistry::FCustomAnimationRegistry(UDataTable* dataTable)
+	: DataTable(dataTable)
+{
+	Rebuild();
+
+#if WITH_EDITOR
+	//Rows can be added, removed or reassigned while editing, so keep the flattened view in step with the table
+	DataTableChangedHandle = dataTable->OnDataTableChanged().AddRaw(this, &FCustomAnimationRegistry::Rebuild);
+#endif
+}
+
+FCustomAnimationRegistry::~FCustomAnimationRegistry()
+{
+#if WITH_EDITOR
+	if (UDataTable* dataTable = DataTable.Get())
+	{
+		dataTable->OnDataTableChanged().Remove(DataTableChangedHandle);
+	}
+#endif
+
+	CustomAnimationRegistry::RegistryMap.Remove(DataTable);
+}
+
+void FCustomAnimationRegistry::Rebuild()
+{
+	Entries.Reset();
+	NameToIndex.Reset();
+
+	UDataTable* dataTable = DataTable.Get();
+	if (!dataTable || !dataTable->GetRowStruct() || !dataTable->GetRowStruct()->IsChildOf(FCustomAnimationStructure::StaticStruct()))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Datatable %s can not be used for custom animations as its rows are not of type FCustomAnimationStructure"), *GetNameSafe(dataTable));
+		return;
+	}
+
+	const TMap<FName, uint8*>& rowMap = dataTable->GetRowMap();
+	Entries.Reserve(rowMap.Num());
+	NameToIndex.Reserve(rowMap.Num());
+
+	for (const TPair<FName, uint8*>& row : rowMap)
+	{
+		const FCustomAnimationStructure* tableRow = reinterpret_cast<const FCustomAnimationStructure*>(row.Value);
+
+		FCustomAnimationRegistryEntry& entry = Entries.AddDefaulted_GetRef();
+		entry.CustomAnimationName = row.Key;
+		entry.AnimationAsset = tableRow->AnimationAsset;
+
+		NameToIndex.Add(row.Key, Entries.Num() - 1);
+	}
+}
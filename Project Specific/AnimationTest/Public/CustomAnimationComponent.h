@@ -7,8 +7,13 @@
 #include "Components/SkeletalMeshComponent.h"
 #include "Engine/DataTable.h"
 #include "Animation/AnimSequenceBase.h"
+#include "Engine/StreamableManager.h"
 #include "CustomAnimationComponent.generated.h"
 
+class FCustomAnimationRegistry;
+class UCustomAnimationComponent;
+struct FAnimMontageInstance;
+
 USTRUCT(BlueprintType)
 struct FCustomAnimationStructure : public FTableRowBase
 {
@@ -18,6 +23,120 @@ public:
 		TSoftObjectPtr<UAnimSequenceBase> AnimationAsset;
 };
 
+USTRUCT(BlueprintType)
+struct FCustomAnimationLoadStats
+{
+	GENERATED_BODY()
+public:
+	//Number of async load requests issued by PlayCustomAnimation
+	UPROPERTY(BlueprintReadOnly)
+		int32 NumRequests = 0;
+
+	//Number of requests whose asset arrived and was handed to playback
+	UPROPERTY(BlueprintReadOnly)
+		int32 NumCompleted = 0;
+
+	//Number of requests cancelled by StopCustomAnimation or EndPlay before the asset arrived
+	UPROPERTY(BlueprintReadOnly)
+		int32 NumCancelled = 0;
+
+	//Time between the request and the asset arriving, in milliseconds
+	UPROPERTY(BlueprintReadOnly)
+		float LastLatencyMs = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly)
+		float AverageLatencyMs = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly)
+		float MaxLatencyMs = 0.0f;
+};
+
+USTRUCT(BlueprintType)
+struct FCustomAnimationDynamicMontageStats
+{
+	GENERATED_BODY()
+public:
+	//Number of sequence plays that reused an existing shared dynamic montage
+	UPROPERTY(BlueprintReadOnly)
+		int32 NumHits = 0;
+
+	//Number of sequence plays that had to create a new shared dynamic montage
+	UPROPERTY(BlueprintReadOnly)
+		int32 NumMisses = 0;
+
+	//Number of dynamic montages shared between all custom animation components
+	UPROPERTY(BlueprintReadOnly)
+		int32 NumSharedMontages = 0;
+
+	//Memory held by the shared dynamic montages. Without sharing, every concurrent sequence play would hold its own montage of about BytesPerMontage
+	UPROPERTY(BlueprintReadOnly)
+		int64 SharedMontageBytes = 0;
+
+	UPROPERTY(BlueprintReadOnly)
+		int64 BytesPerMontage = 0;
+};
+
+UENUM(BlueprintType)
+enum class ECustomAnimationPlayResult : uint8
+{
+	Success,
+	//The asset is being streamed in. The returned ID is a pending handle
+	Pending,
+	InvalidComponent,
+	//No row with this name in the component's DataTable
+	NotFound,
+	AssetNotAssigned,
+	NoAnimInstance,
+	LoadFailed,
+	PlayFailed
+};
+
+USTRUCT(BlueprintType)
+struct FCustomAnimationPlayRequest
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		UCustomAnimationComponent* Component = nullptr;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		FName CustomAnimationName;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		int32 NumLoops = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		FName Slot;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		bool bFreezeOnLastFrame = false;
+};
+
+USTRUCT(BlueprintType)
+struct FCustomAnimationPlayResult
+{
+	GENERATED_BODY()
+public:
+	//Montage instance ID, pending handle (see PlayCustomAnimation) or INDEX_NONE on failure
+	UPROPERTY(BlueprintReadOnly)
+		int32 MontageInstanceID = INDEX_NONE;
+
+	UPROPERTY(BlueprintReadOnly)
+		ECustomAnimationPlayResult Result = ECustomAnimationPlayResult::NotFound;
+};
+
+USTRUCT(BlueprintType)
+struct FCustomAnimationStopRequest
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		UCustomAnimationComponent* Component = nullptr;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		FName CustomAnimationName;
+};
+
 UENUM(BlueprintType)
 enum CustomAnimationStopMode
 {
@@ -34,6 +153,19 @@ DECLARE_DELEGATE_TwoParams(FOnCustomAnimationSectionLooped, FName /*customAnimat
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnCustomAnimationEndedMCDelegate, FName, CustomAnimationName, int32, MontageInstanceID);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnCustomAnimationSectionEndedMCDelegate, FName, CustomAnimationName, int32, MontageInstanceID, FName, SectionName);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnCustomAnimationSectionLoopedMCDelegate, FName, CustomAnimationName, int32, MontageInstanceID, FName, SectionName);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnCustomAnimationStartedMCDelegate, FName, CustomAnimationName, int32, PendingHandle, int32, MontageInstanceID);
+
+//A custom animation that is waiting on its asset to be streamed in before it can be played
+struct FPendingCustomAnimation
+{
+	FName CustomAnimationName;
+	TSoftObjectPtr<UAnimSequenceBase> AnimationAsset;
+	int32 NumLoops;
+	FName Slot;
+	bool bFreezeOnLastFrame;
+	double RequestTime;
+	TSharedPtr<FStreamableHandle> LoadHandle;
+};
 
 /*
 Custom Animation Component
@@ -49,13 +181,47 @@ public:
 	UCustomAnimationComponent();
 
 	//=====Methods
+	//Returns the montage instance ID of the new playback. If the asset has to be streamed in (bStreamAnimationAssets), a negative pending handle
+	//is returned instead and OnCustomAnimationStarted is fired with the real montage instance ID once the asset arrives.
 	UFUNCTION(BlueprintCallable, Category = Animation)
 	int32 PlayCustomAnimation(FName customAnimationName, int32 numLoops, FName slot, bool freezeOnLastFrame);
 
+	//Stops every playing instance of the custom animation, or only the most recently played one if newestOnly is set
+	UFUNCTION(BlueprintCallable, Category = Animation)
+	void StopCustomAnimation(FName customAnimationName, CustomAnimationStopMode stopMode, bool blendOut = true, bool useOutSection = true, bool freezeOnLastFrame = false, bool newestOnly = false);
+
+	//Stops a single instance, as returned by PlayCustomAnimation
+	UFUNCTION(BlueprintCallable, Category = Animation)
+	void StopCustomAnimationInstance(int32 montageInstanceId, CustomAnimationStopMode stopMode, bool blendOut = true, bool useOutSection = true, bool freezeOnLastFrame = false);
+
+	//Plays many custom animations in one call, e.g. a whole crowd reacting at once. Results line up with requests
+	UFUNCTION(BlueprintCallable, Category = Animation)
+	static void PlayCustomAnimationBatch(const TArray<FCustomAnimationPlayRequest>& requests, TArray<FCustomAnimationPlayResult>& results);
+
 	UFUNCTION(BlueprintCallable, Category = Animation)
-	void StopCustomAnimation(FName customAnimationName, CustomAnimationStopMode stopMode, bool blendOut = true, bool useOutSection = true, bool freezeOnLastFrame = false);
+	static void StopCustomAnimationBatch(const TArray<FCustomAnimationStopRequest>& requests, CustomAnimationStopMode stopMode, bool blendOut = true, bool useOutSection = true, bool freezeOnLastFrame = false, bool newestOnly = false);
+
+	UFUNCTION(BlueprintPure, Category = Animation)
+	bool IsCustomAnimationPending(int32 pendingHandle) const { return PendingCustomAnimations.Contains(pendingHandle); }
+
+	UFUNCTION(BlueprintPure, Category = Animation)
+	FCustomAnimationLoadStats GetCustomAnimationLoadStats() const { return LoadStats; }
+
+	UFUNCTION(BlueprintCallable, Category = Animation)
+	void ResetCustomAnimationLoadStats() { LoadStats = FCustomAnimationLoadStats(); }
+
+	//Overrides the mesh that custom animations are played on. Passing null clears the cached binding so it is resolved again on next use
+	UFUNCTION(BlueprintCallable, Category = Animation)
+	void SetTargetMeshComponent(USkeletalMeshComponent* meshComponent);
+
+	//Stats for the dynamic montages shared by every custom animation component
+	UFUNCTION(BlueprintPure, Category = Animation)
+	static FCustomAnimationDynamicMontageStats GetCustomAnimationDynamicMontageStats();
 
 	//Callbacks
+	UFUNCTION()
+	void OnTargetAnimInitialized();
+
 	void OnMontageEnded(UAnimMontage* Montage, bool bInterrupted, int32 MontageInstanceId);
 	void OnMontageSectionEnded(UAnimMontage* Montage, int previousSection, int nextSection, int32 MontageInstanceId);
 
@@ -69,27 +235,69 @@ public:
 	UPROPERTY(BlueprintAssignable)
 	FOnCustomAnimationSectionLoopedMCDelegate OnCustomAnimationSectionLooped;
 
+	//Fired when a streamed custom animation has finished loading and playback has been attempted. MontageInstanceID is INDEX_NONE on failure
+	UPROPERTY(BlueprintAssignable)
+	FOnCustomAnimationStartedMCDelegate OnCustomAnimationStarted;
+
 protected:
 	// Called when the game starts
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	//The mesh and anim instance are resolved once and cached, rather than searching the owner's components on every call
+	USkeletalMeshComponent* GetTargetMeshComponent();
+	UAnimInstance* GetTargetAnimInstance();
 
+	int32 RequestAsyncCustomAnimation(const TSoftObjectPtr<UAnimSequenceBase>& animationAsset, const FName& customAnimationName, int32 numLoops, const FName& slot, bool freezeOnLastFrame);
+	void OnCustomAnimationAssetLoaded(int32 pendingHandle);
+	//Returns the number of pending plays that were cancelled
+	int32 CancelPendingCustomAnimations(const FName& customAnimationName);
+	void CancelPendingCustomAnimation(int32 pendingHandle);
+
+	ECustomAnimationPlayResult PlayRegistryEntry(int32 registryIndex, int32 numLoops, const FName& slot, bool freezeOnLastFrame, int32& outInstanceId);
 	int32 PlayAnimationAsset(UAnimInstance* aniInstance, UAnimSequenceBase* asset, int32 numLoops, const FName& customAnimationName, const FName& slot, const bool freezeOnLastFrame);
-	TSoftObjectPtr<UAnimSequenceBase> GetAssetPtrForName(const FName& customAnimationName);
+	//Returns the registry index of the custom animation, or INDEX_NONE if it is not in the DataTable
+	int32 FindCustomAnimationIndex(const FName& customAnimationName);
 
-	void StopDynamicMontage(UAnimMontage* montage, UAnimInstance* animInstance, CustomAnimationStopMode stopMode, bool blendOut, bool freezeOnLastFrame);
-	void StopDatatableMontage(UAnimMontage* montage, UAnimInstance* animInstance, CustomAnimationStopMode stopMode, bool blendOut, bool useOutSection, bool freezeOnLastFrame);
+	void StopMontageInstance(int32 montageInstanceId, UAnimInstance* animInstance, CustomAnimationStopMode stopMode, bool blendOut, bool useOutSection, bool freezeOnLastFrame);
+	void StopDynamicMontage(FAnimMontageInstance* montageInstance, UAnimInstance* animInstance, CustomAnimationStopMode stopMode, bool blendOut, bool freezeOnLastFrame);
+	void StopDatatableMontage(FAnimMontageInstance* montageInstance, UAnimInstance* animInstance, CustomAnimationStopMode stopMode, bool blendOut, bool useOutSection, bool freezeOnLastFrame, int32 endSectionIndex);
 
 public:	
 	//=====Members
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 		UDataTable* CustomAnimationDataTable;
+
+	//Skeletal mesh to play custom animations on. If not set, the first skeletal mesh component on the owner is used
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		FComponentReference TargetMeshComponent;
+
+	//If true, assets that are not yet loaded are streamed in asynchronously instead of being loaded on the game thread
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		bool bStreamAnimationAssets;
 protected:
-	//Map for noting references to dynamic montages
-	TMap<FName, UAnimMontage*> DynamicMontageMap;
+	//Flattened, shared view of CustomAnimationDataTable
+	TSharedPtr<FCustomAnimationRegistry> Registry;
+
+	//Cached target of PlayCustomAnimation/StopCustomAnimation. The anim instance is cleared whenever the mesh re-initialises its animation
+	TWeakObjectPtr<USkeletalMeshComponent> CachedMeshComponent;
+	TWeakObjectPtr<UAnimInstance> CachedAnimInstance;
+
+	//Instance IDs of every playing instance of each custom animation, oldest first.
+	//The same custom animation can be played again before the previous instance has finished, so there may be several
+	TMap<FName, TArray<int32, TInlineAllocator<2>>> ActiveInstanceIdMap;
 
 	//Map for quick lookup of custom animation name when given a montage.
 	//This is needed as Dynamically created montages will not be given the names of their respective custom animation.
 	TMap<int32, FName> MontageIdNameMap;
 
+	//Custom animations waiting on an async load, keyed by their pending handle
+	TMap<int32, FPendingCustomAnimation> PendingCustomAnimations;
+
+	//Pending handles count down from below INDEX_NONE so they can never collide with a montage instance ID
+	int32 NextPendingHandle;
+
+	FCustomAnimationLoadStats LoadStats;
+
 		
 };
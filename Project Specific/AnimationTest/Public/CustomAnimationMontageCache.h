@@ -0,0 +1,67 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/GCObject.h"
+#include "UObject/ObjectKey.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+
+class UAnimMontage;
+class UAnimSequenceBase;
+
+/*
+Custom Animation Montage Cache
+Sequence assets have to be wrapped in a dynamic montage before they can be played as a custom animation.
+These montages are never modified after creation (loop counts are applied per montage instance), so a single
+montage per (sequence, slot) is shared by every component and every actor playing that sequence.
+The most recently played montages (up to a.CustomAnimation.MontageCacheSize) are held strongly, so a sequence that is played
+again and again survives garbage collection between plays instead of being rebuilt. Every other montage is only weakly referenced.
+It is kept alive by the anim instances playing it, and is garbage collected (along with its reference to the sequence) once nothing
+is playing it, so the cache does not hold on to every sequence ever played.
+*/
+class ANIMATIONTEST_API FCustomAnimationMontageCache : public FGCObject
+{
+public:
+	static FCustomAnimationMontageCache& Get();
+
+	//Returns the shared dynamic montage for the sequence and slot, creating it on first use
+	UAnimMontage* FindOrCreateDynamicMontage(UAnimSequenceBase* sequence, const FName& slot);
+
+	int32 GetNumHits() const { return NumHits; }
+	int32 GetNumMisses() const { return NumMisses; }
+	int32 GetNumSharedMontages() const;
+
+	//Total exclusive size of every shared dynamic montage
+	SIZE_T GetSharedMontageBytes() const;
+
+	// FGCObject interface
+	virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+	virtual FString GetReferencerName() const override { return TEXT("FCustomAnimationMontageCache"); }
+	// End of FGCObject interface
+
+private:
+	//Remove entries whose montage has been garbage collected
+	void RemoveStaleMontages();
+
+	//Move the montage to the back of RecentMontages, dropping the least recently used ones beyond the cache size
+	void MarkRecentlyUsed(UAnimMontage* montage);
+
+	struct FKey
+	{
+		//An object key rather than a pointer, as the address of a collected sequence can be reused
+		FObjectKey Sequence;
+		FName Slot;
+
+		bool operator==(const FKey& Other) const { return Sequence == Other.Sequence && Slot == Other.Slot; }
+		friend uint32 GetTypeHash(const FKey& Key) { return HashCombine(GetTypeHash(Key.Sequence), GetTypeHash(Key.Slot)); }
+	};
+
+	TMap<FKey, TWeakObjectPtr<UAnimMontage>> DynamicMontages;
+
+	//Montages kept alive while idle, least recently used first
+	TArray<UAnimMontage*> RecentMontages;
+
+	int32 NumHits = 0;
+	int32 NumMisses = 0;
+};
@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/SoftObjectPtr.h"
+#include "Animation/AnimSequenceBase.h"
+
+class UDataTable;
+
+//A single custom animation, resolved from a row of the custom animation DataTable
+struct FCustomAnimationRegistryEntry
+{
+	FName CustomAnimationName;
+	TSoftObjectPtr<UAnimSequenceBase> AnimationAsset;
+};
+
+/*
+Custom Animation Registry
+Flattened view of a custom animation DataTable, built once and shared by every component using that table.
+Maps each row name to a compact index so that play/stop lookups do not go through UDataTable::FindRow.
+*/
+class ANIMATIONTEST_API FCustomAnimationRegistry
+{
+public:
+	//Returns the shared registry for the given DataTable, building it if no component currently holds one
+	static TSharedPtr<FCustomAnimationRegistry> Get(UDataTable* dataTable);
+
+	~FCustomAnimationRegistry();
+
+	int32 FindIndex(const FName& customAnimationName) const
+	{
+		const int32* index = NameToIndex.Find(customAnimationName);
+		return index ? *index : INDEX_NONE;
+	}
+
+	const FCustomAnimationRegistryEntry& GetEntry(int32 index) const { return Entries[index]; }
+	int32 Num() const { return Entries.Num(); }
+
+	const UDataTable* GetDataTable() const { return DataTable.Get(); }
+
+private:
+	explicit FCustomAnimationRegistry(UDataTable* dataTable);
+
+	void Rebuild();
+
+	TWeakObjectPtr<UDataTable> DataTable;
+	TArray<FCustomAnimationRegistryEntry> Entries;
+	TMap<FName, int32> NameToIndex;
+
+#if WITH_EDITOR
+	FDelegateHandle DataTableChangedHandle;
+#endif
+};